@@ -25,6 +25,14 @@
 
 #pragma once
 
+/* bus cycle bits compared by the reset detection (all platforms, so the simulator checks the firmware's mask):
+ * address, R/W, ~DEVSEL and bit 26. The IIgs variant pushes its CPLD bits on top, including bit 26. */
+#ifdef ANALOG_GS
+	#define A2_RESET_MASK                      0x3FFFF00
+#else
+	#define A2_RESET_MASK                      0x7FFFF00
+#endif
+
 #ifdef PLATFORM_A2VGA
 
 	#include "a2vga.h"
@@ -40,4 +48,69 @@
 	#define A2_IS_ACCESS_READ(value)           A2VGA_IS_ACCESS_READ()
 	#define A2_IS_RESET(value)                 A2VGA_IS_RESET(value)
 
+	/* platform monitors all bus cycles (reset detection) */
+	#define A2_SNOOP_BUS                       1
+
+	/* platform counts the bus cycles per screen refresh in hardware (PIO) */
+	#define A2_VBL_COUNTER                     1
+	#define A2_VBL_FRACTION_BITS               ABUS_VBL_FRACTION_BITS
+	#define A2_VBL_PERIOD(Period)              abus_vbl_period(Period)
+	#define A2_VBL_ADJUST(Cycles)              abus_vbl_adjust(Cycles)
+	#define A2_VBL_RESTART()                   abus_vbl_restart()
+	#define A2_VBL_TIMER(BusClock)             abus_vbl_timer(BusClock) /* alternatively: hardware alarm */
+	#define A2_VBL_EVENTS()                    abus_vbl_events
+	#define A2_VBL_TIME()                      abus_vbl_time
+	#define A2_VBL_INTERVAL()                  abus_vbl_interval
+	#define A2_VBL_CYCLES()                    abus_vbl_cycles
+
+	/* free running time stamp (microseconds, i.e. about 1 bus cycle) */
+	#define A2_TIMESTAMP()                     (timer_hw->timerawl)
+	#define A2_TIMESTAMP_HZ                    1000000
+
+	/* read data timing, adapted to the phase 0 measured at startup */
+	#define A2_PHASE0_NS()                     abus_phi0_high_ns
+	#define A2_PHASE0_SHORT()                  abus_phi0_short
+	#define A2_READ_ADVANCE_NS()               abus_read_advance_ns
+
+	#ifdef FUNCTION_ROM_DMA
+	/* slot ROM (IOSEL) reads are served by PIO+DMA, without core1 */
+	#define A2_ROM_ENGINE                      1
+	#define A2_ROM_ENGINE_INIT(Rom)            abus_rom_init(Rom)
+	#define A2_ROM_ENGINE_PAGE(Page)           abus_rom_page(Page)
+	#endif
+
+#elif defined(PLATFORM_A2SIM)
+
+	#include "a2sim/a2sim.h"
+
+	#define A2_INIT()                          A2SIM_INIT()
+	#define A2_GETADDRESS(value, address)      A2SIM_GETADDRESS(value, address)
+	#define A2_PUSHDATA(data)                  A2SIM_PUSHDATA(data)
+	#define A2_SET_IRQ(state)                  A2SIM_SET_IRQ(state)
+
+	#define A2_IS_SELECT(address)              A2SIM_IS_SELECT()
+	#define A2_IS_DEVSEL(address)              A2SIM_IS_DEVSEL()
+	#define A2_IS_IOSEL(address)               A2SIM_IS_IOSEL()
+	#define A2_IS_ACCESS_READ(value)           A2SIM_IS_ACCESS_READ()
+	#define A2_IS_RESET(value)                 A2SIM_IS_RESET(value)
+
+	/* platform monitors all bus cycles (reset detection) */
+	#define A2_SNOOP_BUS                       1
+
+	/* platform counts the bus cycles per screen refresh (simulated PIO counter) */
+	#define A2_VBL_COUNTER                     1
+	#define A2_VBL_FRACTION_BITS               A2SIM_VBL_FRACTION_BITS
+	#define A2_VBL_PERIOD(Period)              A2SIM_VBL_PERIOD(Period)
+	#define A2_VBL_ADJUST(Cycles)              A2SIM_VBL_ADJUST(Cycles)
+	#define A2_VBL_RESTART()                   A2SIM_VBL_RESTART()
+	#define A2_VBL_TIMER(BusClock)             A2SIM_VBL_TIMER(BusClock) /* alternatively: simulated alarm */
+	#define A2_VBL_EVENTS()                    A2SimVblEvents
+	#define A2_VBL_TIME()                      A2SimVblTime
+	#define A2_VBL_INTERVAL()                  A2SimVblInterval
+	#define A2_VBL_CYCLES()                    A2SimVblCycles
+
+	/* free running time stamp (bus cycles, at the simulated bus clock) */
+	#define A2_TIMESTAMP()                     A2SimCycles
+	#define A2_TIMESTAMP_HZ                    A2SimBusClock
+
 #endif
@@ -0,0 +1,299 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2024 Thorsten Brehm
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/* a2sim.h: Simulated Apple II bus platform for host (Linux) builds.
+
+   Bus cycles are provided by the simulator instead of the PIO state machines.
+   Each bus cycle uses the same 32bit message format as the A2VGA PIOs:
+     Bits 25-10: address
+     Bit      9: R/W (1=read)
+     Bit      8: ~DEVSEL (0=card selected, i.e. DEVSEL or IOSEL active)
+     Bits  7-0 : data (only valid for write cycles)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Pico SDK function attributes are meaningless on the host. */
+#ifndef __time_critical_func
+  #define __time_critical_func(func) func
+#endif
+#ifndef __always_inline
+  #define __always_inline inline __attribute__((always_inline))
+#endif
+#ifndef __noinline
+  #define __noinline __attribute__((noinline))
+#endif
+
+/* Interrupts only exist on the real hardware. */
+static inline uint32_t save_and_disable_interrupts(void) { return 0; }
+static inline void     restore_interrupts(uint32_t status) { (void) status; }
+
+/* There is only a single (simulated) core, so spin locks never block. */
+typedef volatile uint32_t spin_lock_t;
+static inline spin_lock_t* spin_lock_instance(uint32_t lock_num) { (void) lock_num; return NULL; }
+static inline void     spin_lock_unsafe_blocking(spin_lock_t* lock) { (void) lock; }
+static inline void     spin_unlock_unsafe(spin_lock_t* lock) { (void) lock; }
+static inline uint32_t spin_lock_blocking(spin_lock_t* lock) { (void) lock; return 0; }
+static inline void     spin_unlock(spin_lock_t* lock, uint32_t status) { (void) lock; (void) status; }
+static inline void     spin_lock_claim(uint32_t lock_num) { (void) lock_num; }
+
+/* Average Apple II bus clocks: 14M/14, with one stretched cycle (2 extra 14M clocks) per 65 cycles */
+#define A2SIM_BUSCLOCK_NTSC 1020484 /* 14.31818MHz */
+#define A2SIM_BUSCLOCK_PAL  1015657 /* 14.25045MHz */
+
+/** Simulated VBL bus cycle counter (a PIO state machine on the real hardware). */
+extern volatile uint32_t A2SimVblEvents;
+extern uint32_t A2SimVblCounter;
+extern uint32_t A2SimVblPeriod;
+extern uint32_t A2SimVblFifo[4];
+extern uint32_t A2SimVblFifoLevel;
+extern uint32_t A2SimVblPeriodFixed;
+extern uint32_t A2SimVblFraction;
+extern int32_t  A2SimVblAdjust;
+extern uint32_t A2SimVblTime;
+extern uint32_t A2SimVblInterval;
+extern uint32_t A2SimVblCycles;
+extern bool     A2SimVblRestarted;
+extern uint32_t A2SimVblTimerClock;
+extern uint32_t A2SimVblTimePerCycle;
+extern uint64_t A2SimVblAlarm;
+/** Number of simulated bus cycles (the simulator's time stamp) */
+extern uint32_t A2SimCycles;
+/** Simulated bus clock (Hz), i.e. the rate of the time stamp */
+extern uint32_t A2SimBusClock;
+
+/** Data pushed by the card for the current 6502 read cycle. */
+extern uint32_t A2SimReadData;
+/** Number of bytes pushed by the card since the last bus cycle. */
+extern uint32_t A2SimReadCount;
+/** Current state of the Apple II IRQ line. */
+extern uint32_t A2SimIrq;
+/** State of the reset vector detection. */
+extern uint8_t  A2SimResetState;
+
+#define A2SIM_DEVSEL_BIT  8
+#define A2SIM_RW_BIT      9
+
+/** Provide the next bus cycle message from the simulation input. */
+extern uint32_t A2SimNextCycle(void);
+
+#define A2SIM_INIT()         { A2SimIrq = 0; A2SimResetState = 0; \
+                               A2SimVblEvents = 0; A2SimVblCounter = 0; A2SimVblPeriod = A2SimVblFifoLevel = 0; \
+                               A2SimVblTime = A2SimVblInterval = A2SimVblCycles = 0; A2SimVblRestarted = false; \
+                               A2SimVblPeriodFixed = A2SimVblFraction = 0; A2SimVblAdjust = 0; \
+                               A2SimVblTimerClock = 0; }
+
+#define A2SIM_VBL_FRACTION_BITS 16
+
+/* Like the PIO: periods pass through the (4 entry) TX FIFO and are applied at the next wraps. */
+static inline void A2SIM_VBL_PUT(uint32_t Cycles)
+{
+    if (!A2SimVblPeriod)
+        A2SimVblPeriod = Cycles; // initial period
+    else
+    if (A2SimVblFifoLevel < 4)
+        A2SimVblFifo[A2SimVblFifoLevel++] = Cycles;
+}
+
+/* Like the PIO's pull at a wrap or restart: use a queued period, otherwise keep the current one. */
+static inline void A2SIM_VBL_PULL(void)
+{
+    if (A2SimVblFifoLevel)
+    {
+        A2SimVblPeriod = A2SimVblFifo[0];
+        for (uint32_t i=1;i<A2SimVblFifoLevel;i++)
+            A2SimVblFifo[i-1] = A2SimVblFifo[i];
+        A2SimVblFifoLevel--;
+    }
+}
+
+/* Bus cycles of the next period, accumulating the fractions. */
+static inline uint32_t A2SIM_VBL_TAKE(void)
+{
+    uint32_t Acc = A2SimVblFraction + A2SimVblPeriodFixed;
+    A2SimVblFraction = Acc & ((1u << A2SIM_VBL_FRACTION_BITS)-1);
+    int32_t Cycles = (int32_t)(Acc >> A2SIM_VBL_FRACTION_BITS) + A2SimVblAdjust;
+    A2SimVblAdjust = 0;
+    return (Cycles < 2) ? 2 : Cycles;
+}
+
+/* Like the wrap interrupt: queue the period after the next one. */
+static inline void A2SIM_VBL_NEXT(void)
+{
+    A2SIM_VBL_PUT(A2SIM_VBL_TAKE());
+}
+
+/* Like the alarm: the time (in simulated bus cycles, 24 fraction bits) at the end of the next period. */
+static inline void A2SIM_VBL_ALARM_NEXT(void)
+{
+    A2SimVblPeriod = A2SIM_VBL_TAKE();
+    A2SimVblAlarm += (uint64_t) A2SimVblPeriod * A2SimVblTimePerCycle;
+}
+
+static inline void A2SIM_VBL_PERIOD(uint32_t Period)
+{
+    bool First = (A2SimVblPeriodFixed == 0);
+    A2SimVblPeriodFixed = Period;
+    if ((First)&&(A2SimVblTimerClock))
+        A2SIM_VBL_ALARM_NEXT();
+    else
+    if (First)
+    {
+        A2SIM_VBL_NEXT();
+        A2SIM_VBL_NEXT();
+    }
+}
+
+#define A2SIM_VBL_ADJUST(Cycles) { A2SimVblAdjust += (Cycles); }
+
+static inline void A2SIM_VBL_RESTART(void)
+{
+    if (A2SimVblTimerClock)
+    {
+        A2SimVblAlarm = ((uint64_t) A2SimCycles) << 24;
+        A2SIM_VBL_ALARM_NEXT();
+    }
+    else
+    {
+        A2SimVblCounter = 0;
+        A2SIM_VBL_PULL();
+    }
+    A2SimVblRestarted = true;
+}
+
+/* Like the hardware alarm: VBL events timed for a nominal bus clock (Hz), instead of counting bus cycles (0). */
+static inline void A2SIM_VBL_TIMER(uint32_t BusClock)
+{
+    if (BusClock)
+        A2SimVblTimePerCycle = (uint32_t)((((uint64_t) A2SimBusClock) << 24) / BusClock);
+    if ((BusClock != 0) == (A2SimVblTimerClock != 0))
+    {
+        A2SimVblTimerClock = BusClock;
+        return;
+    }
+    A2SimVblTimerClock = BusClock;
+    A2SimVblPeriod = A2SimVblFifoLevel = A2SimVblCounter = 0;
+    if (A2SimVblPeriodFixed)
+    {
+        // the period starts over
+        if (BusClock)
+        {
+            A2SimVblAlarm = ((uint64_t) A2SimCycles) << 24;
+            A2SIM_VBL_ALARM_NEXT();
+        }
+        else
+        {
+            A2SIM_VBL_NEXT();
+            A2SIM_VBL_NEXT();
+        }
+    }
+    A2SimVblRestarted = true;
+}
+
+/** Count a bus cycle (PHI0 edge) with the simulated VBL counter (or advance the simulated alarm's time). */
+static inline void A2SIM_VBL_CYCLE(void)
+{
+    A2SimCycles++;
+    if (A2SimVblTimerClock)
+    {
+        if ((!A2SimVblPeriod)||((((uint64_t) A2SimCycles) << 24) < A2SimVblAlarm))
+            return;
+    }
+    else
+    if ((!A2SimVblPeriod)||(++A2SimVblCounter < A2SimVblPeriod))
+        return;
+
+    A2SimVblCounter  = 0;
+    A2SimVblCycles   = A2SimVblPeriod;
+    if (!A2SimVblTimerClock)
+        A2SIM_VBL_PULL();
+    A2SimVblInterval = ((A2SimVblEvents)&&(!A2SimVblRestarted)) ? A2SimCycles - A2SimVblTime : 0;
+    A2SimVblRestarted = false;
+    A2SimVblTime     = A2SimCycles;
+    A2SimVblEvents++;
+    if (A2SimVblTimerClock)
+        A2SIM_VBL_ALARM_NEXT();
+    else
+        A2SIM_VBL_NEXT();
+}
+
+#define A2SIM_SET_IRQ(state) A2SimIrq = (state)
+
+#define A2SIM_GETADDRESS(value, address) \
+        value = A2SimNextCycle(); \
+        address = (value >> 10) & 0xffff;
+
+#define A2SIM_PUSHDATA(data) \
+        { A2SimReadData = (data); A2SimReadCount++; }
+
+#define A2SIM_IS_SELECT()      ((value & (1u << A2SIM_DEVSEL_BIT)) == 0)
+#define A2SIM_IS_DEVSEL()      ( (address & 0xff80) == 0xc080)
+#define A2SIM_IS_IOSEL()       (((address & 0xff00) >= 0xc100) && ((address & 0xff00) <= 0xc700))
+#define A2SIM_IS_ACCESS_READ() ((value & (1u << A2SIM_RW_BIT)) != 0)
+
+static __always_inline bool A2SIM_IS_RESET(uint32_t value)
+{
+    switch(A2SimResetState)
+    {
+        case 0:
+            if((value & A2_RESET_MASK) == ((0xFFFC << 10) | 0x300))
+            {
+                A2SimResetState++;
+                return false;
+            }
+            break;
+        case 1:
+            if((value & A2_RESET_MASK) == ((0xFFFD << 10) | 0x300))
+            {
+                 A2SimResetState++;
+                 return false;
+            }
+            break;
+        case 2:
+            if((value & A2_RESET_MASK) == ((0xFA62 << 10) | 0x300))
+            {
+                A2SimResetState++;
+                return true;
+            }
+            break;
+        default:
+            break;
+    }
+    A2SimResetState = 0;
+    return false;
+}
+
+/** Build a bus cycle message, as it would have been sent by the PIOs. */
+static inline uint32_t A2SIM_BUSCYCLE(uint16_t address, bool read, bool selected, uint8_t data)
+{
+    return (((uint32_t) address) << 10) |
+           ((read)     ? (1u << A2SIM_RW_BIT) : 0) |
+           ((selected) ? 0 : (1u << A2SIM_DEVSEL_BIT)) |
+           data;
+}
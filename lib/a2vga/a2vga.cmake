@@ -18,6 +18,14 @@ function(a2vgaConfig BUILDTARGET)
      endif(${CMAKE_CURRENT_BINARY_DIR} MATCHES "-gs")
     endif()
 
+    pico_generate_pio_header(${BUILDTARGET}
+        ${CMAKE_CURRENT_SOURCE_DIR}/lib/a2vga/common/abus-vbl.pio)
+
+    if(${CMAKE_CURRENT_BINARY_DIR} MATCHES "-ROMDMA")
+        pico_generate_pio_header(${BUILDTARGET}
+            ${CMAKE_CURRENT_SOURCE_DIR}/lib/a2vga/common/abus-rom-4ns.pio)
+    endif()
+
     message(STATUS "CMAKE_CURRENT_FUNCTION_LIST_DIR=${CMAKE_CURRENT_FUNCTION_LIST_DIR}")
     target_include_directories(${BUILDTARGET} PUBLIC ${CMAKE_CURRENT_FUNCTION_LIST_DIR})
     # source list
@@ -28,18 +28,17 @@
 #pragma once
 
 #include <hardware/pio.h>
+#include <hardware/timer.h>
 #include "common/abus.h"
 #include "common/buffers.h"
 #include "common/config.h"
 
-extern volatile uint32_t VblBusCycleCounter;
-extern volatile uint32_t VblCycleCount;
-
 #define A2VGA_SET_IRQ(state) gpio_put(CONFIG_PIN_IRQ, state)
 
 static __always_inline bool A2VGA_INIT(void)
 {
     abus_init();
+    abus_vbl_init();
     A2VGA_SET_IRQ(0);
     gpio_init(CONFIG_PIN_IRQ);
     gpio_set_dir(CONFIG_PIN_IRQ, GPIO_OUT);
@@ -63,21 +62,21 @@ static __always_inline bool A2VGA_IS_RESET(uint32_t value)
     switch(reset_state)
     {
         case 0:
-            if((value & 0x7FFFF00) == ((0xFFFC << 10) | 0x300))
+            if((value & A2_RESET_MASK) == ((0xFFFC << 10) | 0x300))
             {
                 reset_state++;
                 return false;
             }
             break;
         case 1:
-            if((value & 0x7FFFF00) == ((0xFFFD << 10) | 0x300))
+            if((value & A2_RESET_MASK) == ((0xFFFD << 10) | 0x300))
             {
                  reset_state++;
                  return false;
             }
             break;
         case 2:
-            if((value & 0x7FFFF00) == ((0xFA62 << 10) | 0x300))
+            if((value & A2_RESET_MASK) == ((0xFA62 << 10) | 0x300))
             {
                 reset_state++;
                 return true;
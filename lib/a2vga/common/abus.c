@@ -1,5 +1,9 @@
 #include <string.h>
 #include <hardware/pio.h>
+#include <hardware/dma.h>
+#include <hardware/clocks.h>
+#include <hardware/sync.h>
+#include <hardware/structs/systick.h>
 #include "common/config.h"
 #include "common/abus.h"
 
@@ -17,6 +21,20 @@
  #endif
 #endif
 
+#ifdef FUNCTION_USB
+ #include <hardware/irq.h>
+ #include <hardware/timer.h>
+ #include <pico/time.h>
+ #include "abus-vbl.pio.h"
+#endif
+
+#ifdef FUNCTION_ROM_DMA
+ #if defined(ANALOG_GS) || !defined(OVERCLOCKED)
+  #error The slot ROM read engine (FUNCTION_ROM_DMA) is only implemented for the 4ns (non-GS) bus timing.
+ #endif
+ #include "abus-rom-4ns.pio.h"
+#endif
+
 #if CONFIG_PIN_APPLEBUS_PHI0 != PHI0_GPIO
 #error CONFIG_PIN_APPLEBUS_PHI0 and PHI0_GPIO must be set to the same pin
 #endif
@@ -25,7 +43,7 @@
 #error The ABUS PIO programs exceed the capacity of the RP2040 PIO (>32 words).
 #endif
 
-static void abus_device_read_setup(PIO pio, uint sm) {
+static uint abus_device_read_setup(PIO pio, uint sm) {
     uint program_offset = pio_add_program(pio, &abus_device_read_program);
     pio_sm_claim(pio, sm);
 
@@ -43,6 +61,93 @@ static void abus_device_read_setup(PIO pio, uint sm) {
     pio_sm_init(pio, sm, program_offset, &c);
 
     // All the GPIOs are shared and setup by the main program
+    return program_offset;
+}
+
+// The PIO programs' delays are tuned for a phase 0 of 489ns (1.023MHz PHI0)
+#define ABUS_PHI0_HIGH_NS      489
+#define ABUS_PHI0_SAMPLES      256
+#define ABUS_PHI0_TIMEOUT      (1u<<20)
+
+uint32_t abus_phi0_high_ns;
+bool     abus_phi0_short;
+uint32_t abus_read_advance_ns;
+
+static bool __not_in_flash_func(abus_phi0_wait)(uint32_t level) {
+    uint32_t timeout = ABUS_PHI0_TIMEOUT;
+    while ((sio_hw->gpio_in & (1u << CONFIG_PIN_APPLEBUS_PHI0)) != level) {
+        if (--timeout == 0)
+            return false;
+    }
+    return true;
+}
+
+// Measure the shortest PHI0 high time (phase 0) with the SysTick counter, which counts
+// system clocks. The polling loops shorten the result a little, which is on the safe side.
+// Returns 0 when there is no bus clock (i.e. the PICO is only powered by USB).
+static uint32_t __not_in_flash_func(abus_phi0_measure)(void) {
+    uint32_t shortest = 0x00ffffff;
+    uint32_t status = save_and_disable_interrupts();
+    systick_hw->rvr = 0x00ffffff;
+    systick_hw->cvr = 0;
+    systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS;
+    for (uint i=0; i<ABUS_PHI0_SAMPLES; i++) {
+        // SysTick counts down
+        if (!abus_phi0_wait(0) || !abus_phi0_wait(1u << CONFIG_PIN_APPLEBUS_PHI0)) {
+            shortest = 0;
+            break;
+        }
+        uint32_t rise = systick_hw->cvr;
+        if (!abus_phi0_wait(0)) {
+            shortest = 0;
+            break;
+        }
+        uint32_t clocks = (rise - systick_hw->cvr) & 0x00ffffff;
+        if (clocks < shortest)
+            shortest = clocks;
+    }
+    systick_hw->csr = 0;
+    restore_interrupts(status);
+    return ((uint64_t) shortest * 1000000000u) / clock_get_hz(clk_sys);
+}
+
+// Move the data output of read cycles to an earlier time when phase 0 is shorter than
+// usual, by patching the delay slots of the device read program (its SM must be stopped).
+// The data is never output later than the program's defaults, and the data is never
+// pulled so early that core1 cannot provide it in time (the 6502 would read 0x00).
+static void abus_device_read_tune(PIO pio, uint program_offset, uint32_t phase0_ns) {
+    const uint delay_shift = 8;    // no side-set: 5 delay bits
+    const uint delay_mask  = 0x1f << delay_shift;
+    uint32_t ns_per_instr = (1000000000u + clock_get_hz(clk_sys) - 1) / clock_get_hz(clk_sys);
+    uint32_t core1_ns     = (uint32_t)(((uint64_t) ABUS_CORE1_READ_CLOCKS * 1000000000u) / clock_get_hz(clk_sys));
+    uint32_t max_earlier  = (core1_ns < ABUS_READ_BUDGET_NS) ? (ABUS_READ_BUDGET_NS - core1_ns) / ns_per_instr : 0;
+
+    abus_phi0_high_ns    = phase0_ns;
+    abus_phi0_short      = false;
+    abus_read_advance_ns = 0;
+    if ((phase0_ns == 0)||(phase0_ns >= ABUS_PHI0_HIGH_NS))
+        return; // no bus clock, or the defaults already fit
+
+    uint16_t instr0 = abus_device_read_program.instructions[abus_device_read_offset_data_delay];
+    uint16_t instr1 = abus_device_read_program.instructions[abus_device_read_offset_data_delay+1];
+    uint32_t delay0 = (instr0 & delay_mask) >> delay_shift;
+    uint32_t delay1 = (instr1 & delay_mask) >> delay_shift;
+
+    uint32_t earlier = (ABUS_PHI0_HIGH_NS - phase0_ns + ns_per_instr - 1) / ns_per_instr;
+    if (max_earlier > delay0 + delay1)
+        max_earlier = delay0 + delay1;
+    if (earlier > max_earlier) {
+        // as early as the program and core1 allow: data is still late, but bus contention is no worse than usual
+        earlier = max_earlier;
+        abus_phi0_short = true;
+    }
+    abus_read_advance_ns = earlier * ns_per_instr;
+    uint32_t delay = delay0 + delay1 - earlier;
+    delay0 = (delay < delay0) ? delay : delay0;
+    delay1 = delay - delay0;
+
+    pio->instr_mem[program_offset + abus_device_read_offset_data_delay]   = (instr0 & ~delay_mask) | (delay0 << delay_shift);
+    pio->instr_mem[program_offset + abus_device_read_offset_data_delay+1] = (instr1 & ~delay_mask) | (delay1 << delay_shift);
 }
 
 static void abus_main_setup(PIO pio, uint sm) {
@@ -109,12 +214,251 @@ static void abus_main_setup(PIO pio, uint sm) {
     }
 }
 
+#ifdef FUNCTION_USB
+volatile uint32_t abus_vbl_events;
+volatile uint32_t abus_vbl_time;
+volatile uint32_t abus_vbl_interval;
+volatile uint32_t abus_vbl_cycles;
+static uint abus_vbl_program_offset;
+static volatile uint32_t abus_vbl_period_fixed; // fixed point bus cycles per screen refresh
+static uint32_t abus_vbl_fraction;              // accumulated fractional bus cycles
+static volatile int32_t abus_vbl_adjust_cycles; // pending phase shift
+static uint32_t abus_vbl_current;               // bus cycles of the running screen refresh period
+static uint32_t abus_vbl_queued;                // bus cycles waiting in the SM's TX FIFO (0: none)
+static bool     abus_vbl_restarted;             // current period was started by abus_vbl_restart
+
+// time based VBL events (abus_vbl_timer): a hardware alarm replaces the PIO counter
+static int      abus_vbl_alarm = -1;            // claimed hardware alarm
+static bool     abus_vbl_timed;                 // VBL events are generated by the alarm
+static uint32_t abus_vbl_us_per_cycle;          // nominal bus cycle time (microseconds, 8.24 fixed point)
+static uint64_t abus_vbl_alarm_target;          // time of the next VBL event (microseconds, 40.24 fixed point)
+
+// Bus cycles of the next screen refresh period. The fractions accumulate, so the
+// average period is exact. Called with interrupts disabled (or from the ISR).
+static uint32_t __time_critical_func(abus_vbl_take)(void) {
+    uint32_t acc = abus_vbl_fraction + abus_vbl_period_fixed;
+    abus_vbl_fraction = acc & ((1u << ABUS_VBL_FRACTION_BITS)-1);
+    int32_t cycles = (int32_t)(acc >> ABUS_VBL_FRACTION_BITS) + abus_vbl_adjust_cycles;
+    abus_vbl_adjust_cycles = 0;
+    return (cycles < 2) ? 2 : cycles;
+}
+
+// Queue the period for the screen refresh after the next one: the SM already
+// pulled the next one. Called with interrupts disabled (or from the ISR).
+static void __time_critical_func(abus_vbl_next)(void) {
+    uint32_t cycles = abus_vbl_take();
+    // never blocks: FIFO only overflows when the interrupts stalled for several screen refreshes
+    ABUS_VBL_PIO->txf[ABUS_VBL_SM] = cycles-1;
+    if (abus_vbl_current)
+        abus_vbl_queued = cycles;
+    else
+        abus_vbl_current = cycles; // initial period
+}
+
+// Arm the alarm for the end of the next screen refresh period (nominal bus cycles).
+// Called with interrupts disabled (or from the ISR).
+static void __time_critical_func(abus_vbl_alarm_next)(void) {
+    abus_vbl_current = abus_vbl_take();
+    abus_vbl_alarm_target += (uint64_t) abus_vbl_current * abus_vbl_us_per_cycle;
+    if (hardware_alarm_set_target(abus_vbl_alarm, from_us_since_boot(abus_vbl_alarm_target >> 24))) {
+        // missed (interrupts were blocked for a long time): start over from now
+        abus_vbl_alarm_target = (time_us_64() << 24) + (uint64_t) abus_vbl_current * abus_vbl_us_per_cycle;
+        hardware_alarm_set_target(abus_vbl_alarm, from_us_since_boot(abus_vbl_alarm_target >> 24));
+    }
+}
+
+// Record a VBL event, common to both sources.
+static void __time_critical_func(abus_vbl_event)(uint32_t now) {
+    // only measure complete periods in between consecutive events
+    abus_vbl_interval = ((abus_vbl_events)&&(!abus_vbl_restarted)) ? now - abus_vbl_time : 0;
+    abus_vbl_cycles = abus_vbl_current;
+    abus_vbl_restarted = false;
+    abus_vbl_time = now;
+    abus_vbl_events++;
+}
+
+static void __time_critical_func(abus_vbl_isr)(void) {
+    uint32_t now = timer_hw->timerawl;
+    pio_interrupt_clear(ABUS_VBL_PIO, 0);
+    abus_vbl_event(now);
+    // the SM has pulled the queued period (otherwise it repeats the current one)
+    if (abus_vbl_queued) {
+        abus_vbl_current = abus_vbl_queued;
+        abus_vbl_queued = 0;
+    }
+    abus_vbl_next();
+}
+
+static void __time_critical_func(abus_vbl_alarm_isr)(uint alarm_num) {
+    (void) alarm_num;
+    abus_vbl_event(timer_hw->timerawl);
+    abus_vbl_alarm_next();
+}
+
+void abus_vbl_init(void) {
+    PIO  pio = ABUS_VBL_PIO;
+    uint sm  = ABUS_VBL_SM;
+    abus_vbl_program_offset = pio_add_program(pio, &abus_vbl_program);
+    pio_sm_claim(pio, sm);
+
+    pio_sm_config c = abus_vbl_program_get_default_config(abus_vbl_program_offset);
+
+    // map the IN pin group to PHI0
+    sm_config_set_in_pins(&c, CONFIG_PIN_APPLEBUS_PHI0);
+
+    pio_sm_init(pio, sm, abus_vbl_program_offset, &c);
+
+    // the counter's wrap interrupt is handled by the calling core
+    pio_set_irq0_source_enabled(pio, pis_interrupt0, true);
+    irq_set_exclusive_handler(PIO0_IRQ_0, abus_vbl_isr);
+    irq_set_enabled(PIO0_IRQ_0, true);
+
+    // the SM waits for its initial period
+    pio_sm_set_enabled(pio, sm, true);
+}
+
+void abus_vbl_period(uint32_t period) {
+    uint32_t status = save_and_disable_interrupts();
+    bool first = (abus_vbl_period_fixed == 0);
+    abus_vbl_period_fixed = period;
+    if ((first)&&(abus_vbl_timed)) {
+        abus_vbl_alarm_next();
+    } else if (first) {
+        // initial period, and the one after the first VBL event
+        abus_vbl_next();
+        abus_vbl_next();
+    }
+    restore_interrupts(status);
+}
+
+void abus_vbl_adjust(int32_t cycles) {
+    uint32_t status = save_and_disable_interrupts();
+    abus_vbl_adjust_cycles += cycles;
+    restore_interrupts(status);
+}
+
+void abus_vbl_restart(void) {
+    uint32_t status = save_and_disable_interrupts();
+    if (abus_vbl_timed) {
+        abus_vbl_alarm_target = time_us_64() << 24;
+        abus_vbl_alarm_next();
+    } else {
+        pio_sm_exec(ABUS_VBL_PIO, ABUS_VBL_SM, pio_encode_jmp(abus_vbl_program_offset + abus_vbl_offset_restart));
+        // the SM pulls the queued period right away
+        if (abus_vbl_queued) {
+            abus_vbl_current = abus_vbl_queued;
+            abus_vbl_queued = 0;
+        }
+    }
+    abus_vbl_restarted = true;
+    restore_interrupts(status);
+}
+
+void abus_vbl_timer(uint32_t bus_clock) {
+    PIO  pio = ABUS_VBL_PIO;
+    uint sm  = ABUS_VBL_SM;
+    if ((bus_clock != 0) == abus_vbl_timed) {
+        // same source: the alarm's clock may change
+        if (bus_clock)
+            abus_vbl_us_per_cycle = (uint32_t)((1000000ull << 24) / bus_clock);
+        return;
+    }
+
+    uint32_t status = save_and_disable_interrupts();
+    abus_vbl_current = abus_vbl_queued = 0;
+    if (bus_clock) {
+        // stop counting bus cycles
+        pio_sm_set_enabled(pio, sm, false);
+        pio_set_irq0_source_enabled(pio, pis_interrupt0, false);
+        pio_interrupt_clear(pio, 0);
+
+        if (abus_vbl_alarm < 0) {
+            abus_vbl_alarm = hardware_alarm_claim_unused(true);
+            hardware_alarm_set_callback(abus_vbl_alarm, abus_vbl_alarm_isr);
+        }
+        abus_vbl_timed = true;
+        abus_vbl_us_per_cycle = (uint32_t)((1000000ull << 24) / bus_clock);
+        abus_vbl_alarm_target = time_us_64() << 24;
+        if (abus_vbl_period_fixed)
+            abus_vbl_alarm_next();
+    } else {
+        hardware_alarm_cancel(abus_vbl_alarm);
+        abus_vbl_timed = false;
+
+        // the SM starts over, waiting for its initial period
+        pio_sm_clear_fifos(pio, sm);
+        pio_sm_restart(pio, sm);
+        pio_sm_exec(pio, sm, pio_encode_jmp(abus_vbl_program_offset));
+        pio_set_irq0_source_enabled(pio, pis_interrupt0, true);
+        pio_sm_set_enabled(pio, sm, true);
+        if (abus_vbl_period_fixed) {
+            abus_vbl_next();
+            abus_vbl_next();
+        }
+    }
+    abus_vbl_restarted = true;
+    restore_interrupts(status);
+}
+#endif
+
+#ifdef FUNCTION_ROM_DMA
+void abus_rom_init(const uint8_t* Rom) {
+    PIO  pio = ABUS_ROM_PIO;
+    uint sm  = ABUS_ROM_SM;
+    uint program_offset = pio_add_program(pio, &abus_rom_read_program);
+    pio_sm_claim(pio, sm);
+
+    pio_sm_config c = abus_rom_read_program_get_default_config(program_offset);
+
+    // set the "device selected" pin as the jump pin
+    sm_config_set_jmp_pin(&c, CONFIG_PIN_APPLEBUS_DEVSEL);
+
+    // map the IN pin group to the data signals (+ ~DEVSEL, R/W)
+    sm_config_set_in_pins(&c, CONFIG_PIN_APPLEBUS_DATA_BASE);
+
+    // left shift into ISR (ROM page|AddrLo) with explicit push, right shift out of OSR (R/W bit)
+    sm_config_set_in_shift(&c, false, false, 32);
+    sm_config_set_out_shift(&c, true, false, 32);
+
+    pio_sm_init(pio, sm, program_offset, &c);
+
+    // sample at the same time as the main SM, which bypasses the input synchronizers as well
+    pio->input_sync_bypass |= (0x3ff << CONFIG_PIN_APPLEBUS_DATA_BASE);
+
+    // initial ROM page
+    pio_sm_put(pio, sm, ((uint32_t) Rom) >> 8);
+
+    // DMA: the ROM byte address from the PIO becomes the read address of the data channel,
+    // which copies the ROM byte to the device read SM. The data channel re-arms the address channel.
+    int chan_addr = dma_claim_unused_channel(true);
+    int chan_data = dma_claim_unused_channel(true);
+
+    dma_channel_config cfg = dma_channel_get_default_config(chan_addr);
+    channel_config_set_transfer_data_size(&cfg, DMA_SIZE_32);
+    channel_config_set_read_increment(&cfg, false);
+    channel_config_set_write_increment(&cfg, false);
+    channel_config_set_dreq(&cfg, pio_get_dreq(pio, sm, false));
+    dma_channel_configure(chan_addr, &cfg, &dma_hw->ch[chan_data].al3_read_addr_trig, &pio->rxf[sm], 1, false);
+
+    cfg = dma_channel_get_default_config(chan_data);
+    channel_config_set_transfer_data_size(&cfg, DMA_SIZE_8);
+    channel_config_set_read_increment(&cfg, false);
+    channel_config_set_write_increment(&cfg, false);
+    channel_config_set_chain_to(&cfg, chan_addr);
+    dma_channel_configure(chan_data, &cfg, &CONFIG_ABUS_PIO->txf[ABUS_DEVICE_READ_SM], Rom, 1, false);
+
+    dma_channel_start(chan_addr);
+    pio_sm_set_enabled(pio, sm, true);
+}
+#endif
 
 void abus_init() {
     // configure state machine to write data for read-cycles to the 6502 bus
-    abus_device_read_setup(CONFIG_ABUS_PIO, ABUS_DEVICE_READ_SM);
+    uint device_read_offset = abus_device_read_setup(CONFIG_ABUS_PIO, ABUS_DEVICE_READ_SM);
     // configure main state machine to monitor 6502 bus cycles
     abus_main_setup(CONFIG_ABUS_PIO, ABUS_MAIN_SM);
+    // adapt the read data timing to the machine's phase 0 (PHI0 is configured now)
+    abus_device_read_tune(CONFIG_ABUS_PIO, device_read_offset, abus_phi0_measure());
 
     pio_enable_sm_mask_in_sync(CONFIG_ABUS_PIO, (1 << ABUS_MAIN_SM) | (1 << ABUS_DEVICE_READ_SM));
 }
@@ -1,7 +1,25 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
+
 void abus_init();
 
+// Core1's time for a read cycle with the default delays: from the main SM's push of
+// the cycle until the device read SM pulls the data (see PROFILER_DEADLINE_NS).
+#define ABUS_READ_BUDGET_NS     296
+// Time core1 needs for a read cycle (system clocks). An estimate with headroom: the
+// DEVSEL/IOSEL read histograms of PROFILER builds show the actual times.
+#define ABUS_CORE1_READ_CLOCKS  32
+
+// shortest phase 0 (PHI0 high time) measured by abus_init (0: no bus clock), whether
+// it was too short for the device read SM to output data in time, and how much
+// earlier the device read SM pulls the data than with the default delays (ns).
+// Phase 0 is only measured once: later speed changes of the bus are not tracked.
+extern uint32_t abus_phi0_high_ns;
+extern bool     abus_phi0_short;
+extern uint32_t abus_read_advance_ns;
+
 #define CARD_SELECT  ((value & (1u << CONFIG_PIN_APPLEBUS_DEVSEL-CONFIG_PIN_APPLEBUS_DATA_BASE)) == 0)
 #define ACCESS_READ  ((value & (1u << CONFIG_PIN_APPLEBUS_RW-CONFIG_PIN_APPLEBUS_DATA_BASE)) != 0)
 #define ACCESS_WRITE ((value & (1u << CONFIG_PIN_APPLEBUS_RW-CONFIG_PIN_APPLEBUS_DATA_BASE)) == 0)
@@ -21,3 +39,51 @@ enum {
     ABUS_MAIN_SM = 0,
     ABUS_DEVICE_READ_SM = 1,
 };
+
+#ifdef FUNCTION_USB
+// VBL bus cycle counter: runs on the other PIO block (the VGA PIO, unused by A2USB)
+#define ABUS_VBL_PIO pio0
+#define ABUS_VBL_SM  1
+
+// number of VBL events (incremented by the counter's wrap interrupt on core0)
+extern volatile uint32_t abus_vbl_events;
+// time of the most recent VBL event, and the time in between the last two (microseconds)
+extern volatile uint32_t abus_vbl_time;
+extern volatile uint32_t abus_vbl_interval;
+// number of bus cycles in between the last two VBL events
+extern volatile uint32_t abus_vbl_cycles;
+
+// start the VBL bus cycle counter (must be called on core0, which receives the interrupts)
+void abus_vbl_init(void);
+
+// VBL periods are fixed point numbers: bus cycles << ABUS_VBL_FRACTION_BITS
+#define ABUS_VBL_FRACTION_BITS 16
+
+// set the number of bus cycles per screen refresh (fixed point, applied from the next but one VBL event)
+void abus_vbl_period(uint32_t period);
+
+// shift the following VBL events by a number of bus cycles (once)
+void abus_vbl_adjust(int32_t cycles);
+
+// begin a new screen refresh period, right now
+void abus_vbl_restart(void);
+
+// generate the VBL events with a hardware alarm, timed for the given nominal bus clock (Hz),
+// instead of counting the bus cycles (0). Periods remain in (nominal) bus cycles.
+void abus_vbl_timer(uint32_t bus_clock);
+#endif
+
+#ifdef FUNCTION_ROM_DMA
+// slot ROM read engine: runs on the other PIO block (the VGA PIO, unused by A2USB)
+#define ABUS_ROM_PIO pio0
+#define ABUS_ROM_SM  0
+
+// start the slot ROM read engine (ROM must be aligned to 256 bytes)
+void abus_rom_init(const uint8_t* Rom);
+
+// select the slot ROM page (256 byte aligned) for the following read cycles
+static inline void abus_rom_page(const uint8_t* Page)
+{
+    ABUS_ROM_PIO->txf[ABUS_ROM_SM] = ((uint32_t) Page) >> 8;
+}
+#endif
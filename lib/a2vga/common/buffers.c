@@ -5,7 +5,12 @@ volatile uint32_t soft_switches = 0;
 volatile uint32_t internal_flags = IFLAGS_OLDCOLOR | IFLAGS_INTERP | IFLAGS_V7_MODE3;
 #endif
 
+#ifdef FUNCTION_USB
+// checked on every bus cycle: part of core1's working set in SCRATCH_Y
+volatile uint8_t __attribute__((section (".scratch_y."))) reset_state = 0;
+#else
 volatile uint8_t reset_state = 0;
+#endif
 
 volatile uint8_t cardslot = 0;
 
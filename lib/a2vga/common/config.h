@@ -56,8 +56,12 @@ extern volatile uint8_t terminal_border;
 #endif // FUNCTION_VGA
 
 #ifdef FUNCTION_USB
+#ifdef ANALOG_GS
+#define CONFIG_PIN_IRQ   12 /* same as VGA VSYNC */
+#else
 #define CONFIG_PIN_IRQ   27 /* same as VGA VSYNC */
 #endif
+#endif
 
 #ifdef FUNCTION_Z80
 typedef enum {
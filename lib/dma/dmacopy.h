@@ -16,3 +16,13 @@ void __noinline memset32(void *dst, uint8_t val, uint32_t size);
 #else
 #define DELAYED_COPY_DATA(n) n
 #endif
+
+/* Core1's working set (bus cycle processing) lives in the scratch banks, which
+ * are not used by core0: code in SCRATCH_X (with core1's stack), data in SCRATCH_Y. */
+#if defined(PICO_BUILD)
+#define CORE1_CODE(n) __attribute__((section(".scratch_x." #n))) n
+#define CORE1_DATA(n) __attribute__((section(".scratch_y." #n))) n
+#else
+#define CORE1_CODE(n) __time_critical_func(n)
+#define CORE1_DATA(n) n
+#endif
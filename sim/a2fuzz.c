@@ -0,0 +1,716 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2024 Thorsten Brehm
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/* a2fuzz.c: Protocol fuzzer and differential tester for the 6805 command emulation.
+
+   Drives random PIA port A/B register sequences through the core1 bus interface
+   (usb_buscycle), with core0 (mouseControllerRun) interleaved at random bus cycle
+   intervals. Most steps follow the 6502 side of the PIA handshake (see
+   MouseInterfaceCard.c), with random or odd command bytes, missing or extra
+   parameter bytes and unexpected reads. Others write random garbage to the PIA
+   registers, after which the handshake must recover.
+
+   Checks:
+     - no stuck handshake: WRACK/RDREADY follow the 6502 within a bounded number of polls,
+     - ReadPos/WritePos bounds, no lost command bytes (MouseEvents queue),
+     - clamp invariants (Min <= Max, position <= Max),
+     - replies and mouse state match a reference model of the 6805 command set.
+
+   The reference model is deliberately simple and independent of the emulation's
+   data structures, including its guesses (parameter counts of COMMAND_A0 and the
+   TIMEMOUSE sub-modes, the "always RDREADY" replies of 0x00). It only follows
+   the implementation's state after garbage was written to the PIA registers.
+   Stops at the first failure, with the seed and step to reproduce it.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "a2platform.h"
+#include "usb/usb.h"
+#include "usb/businterface.c"
+// internal state (Mouse, MouseEvents) is checked against the reference model
+#include "mouse/MouseInterfaceCard.c"
+
+/* PIA registers in slot 4 */
+#define FUZZ_PIBA       0xc0c0
+#define FUZZ_CRA        0xc0c1
+#define FUZZ_PIBB       0xc0c2
+#define FUZZ_CRB        0xc0c3
+
+/* Maximum number of port B polls per handshake step */
+#define FUZZ_POLL_LIMIT 1000
+/* Maximum number of bus cycles in between calls to core0 (the queue holds 32 command bytes) */
+#define FUZZ_CORE0_GAP  200
+
+/* Pending reply bytes: served by core1 */
+#define FUZZ_REPLY_BUFFER Core1Reply.Buffer
+#define FUZZ_REPLY_POS    Core1Reply.Pos
+
+/** Reference model of the 6805's command set */
+typedef struct
+{
+    uint8_t  Command;
+    uint8_t  Params[4];      /**< parameter bytes, in the order they were sent */
+    uint8_t  ParamCount;     /**< number of parameter bytes received */
+    uint8_t  ParamsPending;  /**< number of parameter bytes still expected */
+    uint8_t  Reply[5];       /**< reply bytes, in the order they are read */
+    uint8_t  ReplyMask[5];   /**< bits of the reply bytes which are compared */
+    uint8_t  ReplyLength;
+    uint8_t  ReplyPos;
+    uint8_t  Mode;
+    uint8_t  IntState;       /**< without STATUS_IRQ_VBL, which depends on the bus cycle counter */
+    uint16_t X, Y, LastX, LastY;
+    bool     Button[2], LastButton[2];
+    uint16_t MinX, MinY, MaxX, MaxY;
+    bool     Vbl50Hz;
+    int32_t  PendingX, PendingY; /**< motion since the last snapshot (fixed point, MOTION_FRACTION_BITS) */
+} TFuzzModel;
+
+static TFuzzModel Model;
+
+static uint32_t BusWord;
+static uint32_t Random;
+static uint32_t Seed          = 1;
+static uint32_t Step          = 0;
+static uint32_t Core0Count    = 0;
+static uint32_t Core0Gap      = 1;
+static bool     Verbose       = false;
+static bool     AccelOn       = false; /**< pointer acceleration enabled (-a) */
+static bool     Garbage       = false; /**< random register writes since the last recovery */
+
+/* Statistics */
+static uint32_t CommandCount[16];
+static uint32_t GarbageCount  = 0;
+static uint32_t ReadCount     = 0;
+static uint32_t CompareCount  = 0;
+
+uint32_t A2SimNextCycle(void)
+{
+    A2SIM_VBL_CYCLE();
+    return BusWord;
+}
+
+static uint32_t fuzzRandom(uint32_t Range)
+{
+    // xorshift32
+    Random ^= Random << 13;
+    Random ^= Random >> 17;
+    Random ^= Random << 5;
+    return Random % Range;
+}
+
+static void fuzzFail(const char* Message, uint32_t Actual, uint32_t Expected)
+{
+    printf("FAIL: seed %u, step %u: %s (is %X, expected %X).\n", Seed, Step, Message, Actual, Expected);
+    printf("      Command=%02X WritePos=%u ReadPos=%u X=%u Y=%u Clamp=%u..%u/%u..%u\n",
+           Mouse.Command, Mouse.WritePos, FUZZ_REPLY_POS, Mouse.Current.X, Mouse.Current.Y,
+           Mouse.Clamp.MinX, Mouse.Clamp.MaxX, Mouse.Clamp.MinY, Mouse.Clamp.MaxY);
+    exit(2);
+}
+
+/** Invariants, which hold at any time. */
+static void fuzzInvariants(void)
+{
+    if (FUZZ_REPLY_POS > 5)
+        fuzzFail("ReadPos out of bounds", FUZZ_REPLY_POS, 5);
+    if (Mouse.WritePos > 4)
+        fuzzFail("WritePos out of bounds", Mouse.WritePos, 4);
+    if ((Mouse.Clamp.MinX > Mouse.Clamp.MaxX)||(Mouse.Clamp.MinY > Mouse.Clamp.MaxY))
+        fuzzFail("clamp window inverted", Mouse.Clamp.MinX, Mouse.Clamp.MaxX);
+    if (Mouse.Current.X > Mouse.Clamp.MaxX)
+        fuzzFail("X beyond the clamp window", Mouse.Current.X, Mouse.Clamp.MaxX);
+    if (Mouse.Current.Y > Mouse.Clamp.MaxY)
+        fuzzFail("Y beyond the clamp window", Mouse.Current.Y, Mouse.Clamp.MaxY);
+    if ((!Garbage)&&(MouseEvents.Dropped))
+        fuzzFail("command bytes were lost", MouseEvents.Dropped, 0);
+}
+
+/** A single bus cycle, with core0 running at random intervals. */
+static uint8_t fuzzCycle(uint16_t Address, bool Read, uint8_t Data)
+{
+    bool Selected = ((Address & 0xfff0) == 0xc0c0);
+    uint32_t value, address;
+
+    BusWord = A2SIM_BUSCYCLE(Address, Read, Selected, Data);
+    A2_GETADDRESS(value, address);
+    A2SimReadCount = 0;
+    usb_buscycle(value, address);
+    if ((Selected)&&(Read)&&(A2SimReadCount != 1))
+        fuzzFail("read cycle without data", A2SimReadCount, 1);
+
+    if (++Core0Count >= Core0Gap)
+    {
+        Core0Count = 0;
+        Core0Gap   = 1 + fuzzRandom(FUZZ_CORE0_GAP);
+        mouseControllerRun();
+    }
+    fuzzInvariants();
+    return (Selected) ? A2SimReadData : 0;
+}
+
+/** PIA register access, after the cycles of the 6502 instruction fetch. */
+static uint8_t fuzzAccess(uint16_t Address, bool Read, uint8_t Data)
+{
+    for (uint32_t i=fuzzRandom(4);i<4;i++)
+        fuzzCycle(0x0300+i, true, 0);
+    return fuzzCycle(Address, Read, Data);
+}
+
+static uint8_t fuzzRead(uint16_t Address)
+{
+    return fuzzAccess(Address, true, 0);
+}
+
+static void fuzzWrite(uint16_t Address, uint8_t Data)
+{
+    fuzzAccess(Address, false, Data);
+}
+
+/** Wait for a handshake bit in port B, like the ROM does (but with a limit). */
+static void fuzzPoll(uint8_t Mask, uint8_t Value, const char* What)
+{
+    for (uint32_t i=0;i<FUZZ_POLL_LIMIT;i++)
+    {
+        if ((fuzzRead(FUZZ_PIBB) & Mask) == Value)
+            return;
+    }
+    fuzzFail(What, Pia.IB, Value);
+}
+
+/** PIA setup of the ROM's initialization (port B: bits 1-5 are outputs). */
+static void fuzzSetup(void)
+{
+    fuzzWrite(FUZZ_CRB,  0x00);
+    fuzzWrite(FUZZ_PIBB, 0x3E);
+    fuzzWrite(FUZZ_CRB,  0x04);
+    fuzzWrite(FUZZ_PIBB, 0x00);
+}
+
+/** Port A direction. */
+static void fuzzPortA(uint8_t Direction)
+{
+    fuzzWrite(FUZZ_CRA,  0x00);
+    fuzzWrite(FUZZ_PIBA, Direction);
+    fuzzWrite(FUZZ_CRA,  0x04);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Reference model                                                           */
+
+/** Number of parameter bytes of a command. */
+static uint8_t modelParamCount(uint8_t Command)
+{
+    switch (Command & 0xf0)
+    {
+        case COMMAND_POSMOUSE:   return 4;
+        case COMMAND_CLAMPMOUSE: return 4;
+        case COMMAND_A0:         return 1;
+        case COMMAND_RDMEMMOUSE: return 2;
+        case COMMAND_TIMEMOUSE:  return (uint8_t[]){0, 2, 1, 3}[(Command >> 2) & 3];
+        default:                 return 0;
+    }
+}
+
+static void modelReply(const uint8_t* Data, const uint8_t* Mask, uint8_t Length)
+{
+    memcpy(Model.Reply, Data, Length);
+    memcpy(Model.ReplyMask, Mask, Length);
+    Model.ReplyLength = Length;
+    Model.ReplyPos    = 0;
+}
+
+static void modelClamp(void)
+{
+    Model.X = (Model.X < Model.MinX) ? Model.MinX : (Model.X > Model.MaxX) ? Model.MaxX : Model.X;
+    Model.Y = (Model.Y < Model.MinY) ? Model.MinY : (Model.Y > Model.MaxY) ? Model.MaxY : Model.Y;
+}
+
+static void modelHome(void)
+{
+    Model.X = Model.LastX = Model.MinX;
+    Model.Y = Model.LastY = Model.MinY;
+}
+
+/** Move the position, clamped in the direction of the movement. */
+static void modelPosition(int32_t dx, int32_t dy)
+{
+    uint16_t OldX = Model.X, OldY = Model.Y;
+    int32_t  X = Model.X + dx, Y = Model.Y + dy;
+
+    if (dx > 0)
+        Model.X = (X > Model.MaxX) ? Model.MaxX : X;
+    else
+        Model.X = (X < Model.MinX) ? Model.MinX : X;
+    if (dy > 0)
+        Model.Y = (Y > Model.MaxY) ? Model.MaxY : Y;
+    else
+        Model.Y = (Y < Model.MinY) ? Model.MinY : Y;
+
+    if ((Model.X != OldX)||(Model.Y != OldY))
+    {
+        Model.IntState |= STATUS_MOVED;
+        if ((Model.Mode & MOUSE_MODE_MOVED_IRQ) == MOUSE_MODE_MOVED_IRQ)
+            Model.IntState |= STATUS_IRQ_MOVEMENT;
+    }
+}
+
+/** Snapshot of the accumulated motion: whole units move the position, fractions remain. */
+static void modelFlush(void)
+{
+    int32_t dx = Model.PendingX >> MOTION_FRACTION_BITS;
+    int32_t dy = Model.PendingY >> MOTION_FRACTION_BITS;
+    if ((dx)||(dy))
+        modelPosition(dx, dy);
+    Model.PendingX -= dx * (1 << MOTION_FRACTION_BITS);
+    Model.PendingY -= dy * (1 << MOTION_FRACTION_BITS);
+}
+
+static int32_t modelSaturate(int64_t Motion)
+{
+    return (Motion > MOTION_LIMIT) ? MOTION_LIMIT : (Motion < -MOTION_LIMIT) ? -MOTION_LIMIT : (int32_t) Motion;
+}
+
+/** Gain of a report (fixed point). The curve is the implementation's, its scaling is modeled. */
+static int32_t modelGain(int16_t dx, int16_t dy)
+{
+    if (!AccelOn)
+        return 1 << MOTION_FRACTION_BITS;
+    uint32_t Speed  = ((abs(dx) > abs(dy)) ? abs(dx) : abs(dy)) / 2;
+    uint32_t Window = Model.MaxX - Model.MinX + 1;
+    uint32_t Gain   = AccelCurve[(Speed < ACCEL_SPEEDS) ? Speed : ACCEL_SPEEDS-1] * Window / 1024;
+    return (Gain > 0xFFFF) ? 0xFFFF : Gain;
+}
+
+static void modelMove(int16_t dx, int16_t dy)
+{
+    int32_t Gain = modelGain(dx, dy);
+    Model.PendingX = modelSaturate(Model.PendingX + (int64_t) dx*Gain);
+    Model.PendingY = modelSaturate(Model.PendingY + (int64_t) dy*Gain);
+    if ((Model.Mode & MOUSE_MODE_MOVED_IRQ) == MOUSE_MODE_MOVED_IRQ)
+        modelFlush();
+}
+
+static void modelCommand(void)
+{
+    static const uint8_t All[5] = {0xff, 0xff, 0xff, 0xff, 0xff};
+    const uint8_t* p = Model.Params;
+    uint8_t Status;
+
+    CommandCount[Model.Command >> 4]++;
+    modelFlush();
+    switch (Model.Command & 0xf0)
+    {
+        case COMMAND_SETMOUSE:
+            Model.Mode = Model.Command & 0x0f;
+            break;
+        case COMMAND_READMOUSE:
+            Status = (Model.IntState & STATUS_MOVED) |
+                     ((Model.LastButton[0]) ? STATUS_WAS_BUTTON0 : 0) | ((Model.LastButton[1]) ? STATUS_WAS_BUTTON1 : 0) |
+                     ((Model.Button[0])     ? STATUS_IS_BUTTON0  : 0) | ((Model.Button[1])     ? STATUS_IS_BUTTON1  : 0);
+            modelReply((uint8_t[]){Model.X, Model.X >> 8, Model.Y, Model.Y >> 8, Status}, All, 5);
+            // the interrupt flags are cleared as well, the button states remain
+            Model.IntState = Status & ~STATUS_MOVED;
+            Model.LastX = Model.X;
+            Model.LastY = Model.Y;
+            Model.LastButton[0] = Model.Button[0];
+            Model.LastButton[1] = Model.Button[1];
+            break;
+        case COMMAND_SERVEMOUSE:
+            modelReply((uint8_t[]){Model.IntState & ~STATUS_MOVED}, (uint8_t[]){~STATUS_IRQ_VBL}, 1);
+            Model.IntState &= ~(STATUS_IRQ_MOVEMENT|STATUS_IRQ_BUTTON);
+            break;
+        case COMMAND_CLEARMOUSE:
+            Model.X = Model.Y = 0;
+            break;
+        case COMMAND_POSMOUSE:
+            Model.X = p[0] | (p[1] << 8);
+            Model.Y = p[2] | (p[3] << 8);
+            modelClamp();
+            Model.LastX = Model.X;
+            Model.LastY = Model.Y;
+            break;
+        case COMMAND_INITMOUSE:
+            Model.MinX = Model.MinY = 0;
+            Model.MaxX = Model.MaxY = 1023;
+            modelHome();
+            break;
+        case COMMAND_CLAMPMOUSE:
+        {
+            uint16_t Min = p[0] | (p[2] << 8);
+            uint16_t Max = p[1] | (p[3] << 8);
+            if (Min > Max)
+            {
+                Max = (Min + Max) / 2;
+                Min = 0;
+            }
+            if (Model.Command & 1)
+            {
+                Model.MinY = Min;
+                Model.MaxY = Max;
+            }
+            else
+            {
+                Model.MinX = Min;
+                Model.MaxX = Max;
+            }
+            modelClamp();
+            break;
+        }
+        case COMMAND_HOMEMOUSE:
+            modelHome();
+            break;
+        case COMMAND_TIMEMOUSE:
+            Model.Vbl50Hz = Model.Command & 1;
+            break;
+        case COMMAND_RDMEMMOUSE:
+        {
+            uint16_t Address = p[0] | (p[1] << 8);
+            uint16_t Clamp[4] = {Model.MinX, Model.MinY, Model.MaxX, Model.MaxY};
+            uint8_t  Data = 0x00;
+            if ((Address >= 0x47)&&(Address <= 0x4e))
+            {
+                // high bytes first: MinXH, MinYH, MinXL, MinYL, MaxXH, ...
+                uint32_t i = Address - 0x47;
+                uint16_t Value = Clamp[(i & 1) | ((i >> 2) << 1)];
+                Data = (i & 2) ? Value : Value >> 8;
+            }
+            modelReply(&Data, All, 1);
+            break;
+        }
+        default:
+            // unknown commands: no reply
+            break;
+    }
+}
+
+/** The 6502 sent a byte. */
+static void modelSend(uint8_t Data)
+{
+    // any byte drops the remaining reply
+    Model.ReplyLength = Model.ReplyPos = 0;
+    if (Model.ParamsPending)
+    {
+        Model.Params[Model.ParamCount++] = Data;
+        Model.ParamsPending--;
+    }
+    else
+    {
+        Model.Command       = Data;
+        Model.ParamCount    = 0;
+        Model.ParamsPending = modelParamCount(Data);
+    }
+    if (!Model.ParamsPending)
+        modelCommand();
+}
+
+/** The 6502 read a byte: the next reply byte, or 0x00 (always RDREADY). */
+static void modelReceive(uint8_t Data)
+{
+    uint8_t Expected = 0x00, Mask = 0xff;
+    if (Model.ReplyPos < Model.ReplyLength)
+    {
+        Expected = Model.Reply[Model.ReplyPos];
+        Mask     = Model.ReplyMask[Model.ReplyPos++];
+    }
+    ReadCount++;
+    if ((Data ^ Expected) & Mask)
+        fuzzFail("reply mismatch", Data, Expected);
+}
+
+static void modelButton(uint8_t ButtonNr, bool Pressed)
+{
+    Model.Button[ButtonNr] = Pressed;
+    if ((Model.Mode & MOUSE_MODE_BUTTON_IRQ) == MOUSE_MODE_BUTTON_IRQ)
+        Model.IntState |= STATUS_IRQ_BUTTON;
+}
+
+/** Take over the implementation's state (after garbage was written to the PIA). */
+static void modelSync(void)
+{
+    Model.Command       = Mouse.Command;
+    Model.ParamsPending = Mouse.WritePos;
+    Model.ParamCount    = modelParamCount(Mouse.Command) - Mouse.WritePos;
+    for (uint32_t i=0;i<Model.ParamCount;i++)
+        Model.Params[i] = Mouse.WriteBuffer[modelParamCount(Mouse.Command)-1-i];
+    Model.ReplyLength = FUZZ_REPLY_POS;
+    Model.ReplyPos    = 0;
+    for (uint32_t i=0;i<FUZZ_REPLY_POS;i++)
+    {
+        Model.Reply[i]     = FUZZ_REPLY_BUFFER[FUZZ_REPLY_POS-1-i];
+        Model.ReplyMask[i] = 0xff;
+    }
+    Model.Mode          = Mouse.OperatingMode;
+    Model.IntState      = Mouse.IntState & ~STATUS_IRQ_VBL;
+    Model.X             = Mouse.Current.X;
+    Model.Y             = Mouse.Current.Y;
+    Model.LastX         = Mouse.Last.X;
+    Model.LastY         = Mouse.Last.Y;
+    Model.Button[0]     = Mouse.Current.Button0;
+    Model.Button[1]     = Mouse.Current.Button1;
+    Model.LastButton[0] = Mouse.Last.Button0;
+    Model.LastButton[1] = Mouse.Last.Button1;
+    Model.MinX          = Mouse.Clamp.MinX;
+    Model.MinY          = Mouse.Clamp.MinY;
+    Model.MaxX          = Mouse.Clamp.MaxX;
+    Model.MaxY          = Mouse.Clamp.MaxY;
+    Model.Vbl50Hz       = Mouse.Vbl50HzMode;
+    Model.PendingX      = Mouse.Motion.X;
+    Model.PendingY      = Mouse.Motion.Y;
+}
+
+/** Compare the implementation's state, once core0 processed all command bytes. */
+static void modelCompare(void)
+{
+    if (!spscQueueEmpty(&MouseEvents))
+        return;
+    CompareCount++;
+    // VBL interrupts take snapshots at times the model doesn't know (only fractions remain)
+    if ((Mouse.Motion.X >> MOTION_FRACTION_BITS == 0)&&(Mouse.Motion.Y >> MOTION_FRACTION_BITS == 0))
+        modelFlush();
+    if ((Mouse.Motion.X != Model.PendingX)||(Mouse.Motion.Y != Model.PendingY))
+        fuzzFail("pending motion", Mouse.Motion.X, Model.PendingX);
+    if (Mouse.WritePos != Model.ParamsPending)
+        fuzzFail("pending parameter bytes", Mouse.WritePos, Model.ParamsPending);
+    if ((Mouse.WritePos)||(modelParamCount(Mouse.Command) == 0)||(Model.ParamCount))
+    {
+        if (Mouse.Command != Model.Command)
+            fuzzFail("command", Mouse.Command, Model.Command);
+    }
+    if (Mouse.OperatingMode != Model.Mode)
+        fuzzFail("operating mode", Mouse.OperatingMode, Model.Mode);
+    if ((Mouse.IntState & ~STATUS_IRQ_VBL) != Model.IntState)
+        fuzzFail("status", Mouse.IntState, Model.IntState);
+    if ((Mouse.Current.X != Model.X)||(Mouse.Current.Y != Model.Y))
+        fuzzFail("position", (Mouse.Current.X << 16) | Mouse.Current.Y, (Model.X << 16) | Model.Y);
+    if ((Mouse.Last.X != Model.LastX)||(Mouse.Last.Y != Model.LastY))
+        fuzzFail("last position", (Mouse.Last.X << 16) | Mouse.Last.Y, (Model.LastX << 16) | Model.LastY);
+    if ((Mouse.Clamp.MinX != Model.MinX)||(Mouse.Clamp.MaxX != Model.MaxX))
+        fuzzFail("X clamp window", (Mouse.Clamp.MinX << 16) | Mouse.Clamp.MaxX, (Model.MinX << 16) | Model.MaxX);
+    if ((Mouse.Clamp.MinY != Model.MinY)||(Mouse.Clamp.MaxY != Model.MaxY))
+        fuzzFail("Y clamp window", (Mouse.Clamp.MinY << 16) | Mouse.Clamp.MaxY, (Model.MinY << 16) | Model.MaxY);
+    if (Mouse.Vbl50HzMode != Model.Vbl50Hz)
+        fuzzFail("50Hz mode", Mouse.Vbl50HzMode, Model.Vbl50Hz);
+}
+
+/* ------------------------------------------------------------------------- */
+/* 6502 side                                                                 */
+
+/** Write transfer (6502=>6805). */
+static void fuzzSend(uint8_t Data)
+{
+    if (Verbose)
+        printf("%8u: send %02X\n", Step, Data);
+    fuzzPortA(0xff);
+    fuzzWrite(FUZZ_PIBA, Data);
+    fuzzWrite(FUZZ_PIBB, PIA_PORTB_WRREQUEST);
+    fuzzPoll(PIA_PORTB_WRACK, PIA_PORTB_WRACK, "stuck handshake: no WRACK");
+    fuzzWrite(FUZZ_PIBB, 0);
+    fuzzPoll(PIA_PORTB_WRACK, 0, "stuck handshake: WRACK not released");
+    modelSend(Data);
+}
+
+/** Read transfer (6805=>6502). */
+static void fuzzReceive(void)
+{
+    fuzzPortA(0x00);
+    fuzzPoll(PIA_PORTB_RDREADY, PIA_PORTB_RDREADY, "stuck handshake: no RDREADY");
+    uint8_t Data = fuzzRead(FUZZ_PIBA);
+    fuzzWrite(FUZZ_PIBB, PIA_PORTB_RDACK);
+    fuzzPoll(PIA_PORTB_RDREADY, 0, "stuck handshake: RDREADY not released");
+    fuzzWrite(FUZZ_PIBB, 0);
+    if (Verbose)
+        printf("%8u: read %02X\n", Step, Data);
+    modelReceive(Data);
+}
+
+/** A command with plausible parameters, followed by a random number of reads. */
+static void fuzzCommand(void)
+{
+    static const uint8_t Commands[] =
+    {
+        COMMAND_SETMOUSE, COMMAND_READMOUSE, COMMAND_SERVEMOUSE, COMMAND_CLEARMOUSE, COMMAND_POSMOUSE,
+        COMMAND_INITMOUSE, COMMAND_CLAMPMOUSE, COMMAND_HOMEMOUSE, COMMAND_TIMEMOUSE, COMMAND_RDMEMMOUSE,
+        COMMAND_80, COMMAND_A0, COMMAND_B0, COMMAND_C0, COMMAND_D0, COMMAND_E0
+    };
+    uint8_t Command = Commands[fuzzRandom(sizeof(Commands))] | fuzzRandom(16);
+    uint8_t Params  = modelParamCount(Command);
+
+    fuzzSend(Command);
+    // sometimes the full 16bit clamp window (maximum acceleration gain)
+    bool FullWindow = ((Command & 0xf0) == COMMAND_CLAMPMOUSE)&&(fuzzRandom(8) == 0);
+    for (uint32_t i=0;i<Params;i++)
+    {
+        uint8_t Data = fuzzRandom(256);
+        if ((Command & 0xf0) == COMMAND_RDMEMMOUSE)
+            Data = (i == 0) ? 0x40 + fuzzRandom(16) : 0x00; // mostly the documented clamp addresses
+        if (FullWindow)
+            Data = (i & 1) ? 0xff : 0x00; // min $0000, max $FFFF
+        fuzzSend(Data);
+    }
+    // the expected number of reads, a few more or less
+    int32_t Reads = Model.ReplyLength + fuzzRandom(4) - 1;
+    for (int32_t i=0;i<Reads;i++)
+        fuzzReceive();
+}
+
+/** Reports from the USB mouse, which core0 processes in between its mouseControllerRun calls. */
+static void fuzzMouse(bool Move)
+{
+    // the model processes command bytes as soon as they are sent
+    mouseControllerRun();
+    if (Move)
+    {
+        // boot protocol deltas, or the full 16bit range of report protocol mice
+        int32_t Range = (fuzzRandom(4)) ? 256 : 65536;
+        int16_t dx = fuzzRandom(Range) - Range/2;
+        int16_t dy = fuzzRandom(Range) - Range/2;
+        // sometimes the extremes, which saturate the motion accumulator
+        if (fuzzRandom(16) == 0)
+            dx = (fuzzRandom(2)) ? INT16_MAX : INT16_MIN;
+        if (Verbose)
+            printf("%8u: move %d,%d\n", Step, dx, dy);
+        mouseControllerMoveXY(dx, dy);
+        modelMove(dx, dy);
+    }
+    else
+    {
+        uint8_t ButtonNr = fuzzRandom(2);
+        bool    Pressed  = fuzzRandom(2);
+        if (Verbose)
+            printf("%8u: button %u %s\n", Step, ButtonNr, (Pressed) ? "down" : "up");
+        mouseControllerUpdateButton(ButtonNr, Pressed);
+        modelButton(ButtonNr, Pressed);
+    }
+}
+
+/** Random PIA register writes and reads, then recover like the ROM's initialization. */
+static void fuzzGarbage(void)
+{
+    if (Verbose)
+        printf("%8u: garbage\n", Step);
+    Garbage = true;
+    GarbageCount++;
+    for (uint32_t i=fuzzRandom(32);i<32;i++)
+    {
+        uint16_t Address = FUZZ_PIBA + fuzzRandom(4);
+        if (fuzzRandom(2))
+            fuzzRead(Address);
+        else
+            fuzzWrite(Address, fuzzRandom(256));
+    }
+    fuzzSetup();
+    // core0 catches up, so the model can take over the state
+    while (!spscQueueEmpty(&MouseEvents))
+        fuzzCycle(0x0300, true, 0);
+    MouseEvents.Dropped = 0;
+    Garbage = false;
+    modelSync();
+}
+
+static void fuzzRun(uint32_t Steps)
+{
+    Random = Seed ? Seed : 1;
+    A2_INIT();
+    mouseControllerInit();
+    mouseControllerAccel(AccelOn);
+    usb_core1_init();
+    usb_reset();
+    memset(&MouseEvents, 0, sizeof(MouseEvents));
+    fuzzSetup();
+    modelSync();
+
+    for (Step=0;Step<Steps;Step++)
+    {
+        uint32_t Choice = fuzzRandom(100);
+        if (Choice < 45)
+            fuzzCommand();
+        else
+        if (Choice < 60)
+            fuzzSend(fuzzRandom(256)); // any byte: commands or parameters
+        else
+        if (Choice < 70)
+            fuzzReceive();
+        else
+        if (Choice < 95)
+            fuzzMouse(Choice < 85);
+        else
+            fuzzGarbage();
+        modelCompare();
+    }
+}
+
+static void fuzzReport(uint32_t Steps)
+{
+    printf("Seed %u: %u steps, %u comparisons, %u reads, %u garbage bursts\n",
+           Seed, Steps, CompareCount, ReadCount, GarbageCount);
+    printf("Commands:");
+    for (uint32_t i=0;i<16;i++)
+        printf(" %X0:%u", i, CommandCount[i]);
+    printf("\n");
+}
+
+static void usage(const char* Name)
+{
+    fprintf(stderr,
+            "Usage: %s [-v] [-a] [-s seed] [-n steps]\n"
+            "  -v  print all bytes sent and read\n"
+            "  -a  enable pointer acceleration (off by default)\n"
+            "  -s  random seed (default: 1)\n"
+            "  -n  number of random steps (default: 100000)\n",
+            Name);
+}
+
+int main(int argc, char* argv[])
+{
+    uint32_t Steps = 100000;
+    int      opt;
+
+    while ((opt = getopt(argc, argv, "vas:n:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'v': Verbose = true; break;
+            case 'a': AccelOn = true; break;
+            case 's': Seed    = strtoul(optarg, NULL, 0); break;
+            case 'n': Steps   = strtoul(optarg, NULL, 0); break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (optind != argc)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    fuzzRun(Steps);
+    fuzzReport(Steps);
+    return 0;
+}
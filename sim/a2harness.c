@@ -0,0 +1,472 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2024 Thorsten Brehm
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/* a2harness.c: Runs the real MouseInterfaceROM on a simulated 6502.
+
+   A small 6502 core (cpu6502.c) executes Apple II software, which calls the mouse
+   firmware like MOUSE.SAMPLE.asm does (see test/): through the entry point offsets
+   at $Cn12..$Cn19, with X=Cn and Y=n0. Every 6502 cycle is a bus cycle, which is
+   passed to the same core1 bus interface code which runs on the PICO (usb_buscycle).
+   So the slot ROM is served by the card emulation, including the ROM paging through
+   the PIA's port B. The core0 part (mouseControllerRun) is interleaved at a fixed
+   bus cycle interval, so results are deterministic.
+
+   Reports the number of 6502 cycles per firmware call, i.e. the latency as seen by
+   Apple II software, and verifies the results in the screen holes.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "a2platform.h"
+#include "usb/usb.h"
+#include "usb/businterface.c"
+#include "cpu6502.h"
+
+/* Firmware entry point offsets (MOUSE.SAMPLE.asm) */
+enum
+{
+    HARNESS_SETMOUSE   = 0x12,
+    HARNESS_SERVEMOUSE = 0x13,
+    HARNESS_READMOUSE  = 0x14,
+    HARNESS_CLEARMOUSE = 0x15,
+    HARNESS_POSMOUSE   = 0x16,
+    HARNESS_CLAMPMOUSE = 0x17,
+    HARNESS_HOMEMOUSE  = 0x18,
+    HARNESS_INITMOUSE  = 0x19,
+    HARNESS_ENTRIES    = 8
+};
+
+static const char* HarnessEntryNames[HARNESS_ENTRIES] =
+{
+    "SETMOUSE",
+    "SERVEMOUSE",
+    "READMOUSE",
+    "CLEARMOUSE",
+    "POSMOUSE",
+    "CLAMPMOUSE",
+    "HOMEMOUSE",
+    "INITMOUSE"
+};
+
+typedef struct
+{
+    uint32_t Count;
+    uint64_t Total;
+    uint32_t Min;
+    uint32_t Max;
+} THarnessStats;
+
+static THarnessStats HarnessStats[HARNESS_ENTRIES];
+
+/* Screen holes (+n) */
+#define HOLE_XL     0x478
+#define HOLE_YL     0x4F8
+#define HOLE_XH     0x578
+#define HOLE_YH     0x5F8
+#define HOLE_STATUS 0x778
+
+/* CALLCARD of MOUSE.SAMPLE.asm at $0300, with CN/N0 at $0320/$0321 and TOCARD at $0322.
+   The stub loops at $0313 when the firmware call returned. */
+#define CALLCARD    0x0300
+#define CALLCARD_JSR  0x0310
+#define CALLCARD_DONE 0x0313
+#define TMP         0x06    /* pointer to $Cn00 */
+#define CN          0x0320
+#define N0          0x0321
+#define TOCARD      0x0322
+
+static const uint8_t CallCard[] =
+{
+    0x48,             // PHA
+    0xB1, TMP,        // LDA (TMP),Y
+    0xAE, 0x20, 0x03, // LDX CN
+    0xAC, 0x21, 0x03, // LDY N0
+    0x8D, 0x23, 0x03, // STA TOCARD+1
+    0x8E, 0x24, 0x03, // STX TOCARD+2
+    0x68,             // PLA
+    0x20, 0x22, 0x03, // JSR TOCARD
+    0x4C, 0x13, 0x03  // JMP *
+};
+
+/* Maximum number of 6502 cycles per firmware call */
+#define HARNESS_TIMEOUT 1000000
+
+/* Apple II video timing, for the $C019 (RDVBLBAR) soft switch */
+#define HARNESS_FRAME_CYCLES 17030
+#define HARNESS_VBL_START    12480
+
+static TCpu6502 Cpu;
+static uint8_t  Memory[0x10000];
+static uint32_t Slot          = 4;
+static uint32_t Core0Interval = 8;
+static uint32_t Core0Count    = 0;
+static uint32_t BusWord;
+static bool     Verbose       = false;
+
+/* Errors: read cycles without (or with multiple) data bytes for the 6502 */
+static uint32_t ReadErrors    = 0;
+/* Errors: unexpected firmware results */
+static uint32_t ResultErrors  = 0;
+
+uint32_t A2SimNextCycle(void)
+{
+    A2SIM_VBL_CYCLE();
+    return BusWord;
+}
+
+/** A single 6502 bus cycle: passed to the card, then served by the Apple II (unless the card was selected). */
+static uint8_t harnessCycle(uint16_t Address, bool Read, uint8_t Data)
+{
+    bool Selected = ((Address & 0xfff0) == (0xc080 | (Slot << 4))) ||
+                    ((Address & 0xff00) == (0xc000 | (Slot << 8)));
+    uint32_t value, address;
+
+    BusWord = A2SIM_BUSCYCLE(Address, Read, Selected, Data);
+    A2_GETADDRESS(value, address);
+    A2SimReadCount = 0;
+    usb_buscycle(value, address);
+
+    // give core0 a chance to process the PIA state
+    if (++Core0Count >= Core0Interval)
+    {
+        Core0Count = 0;
+        mouseControllerRun();
+    }
+
+    if (Selected)
+    {
+        if (!Read)
+            return 0;
+        if (A2SimReadCount != 1)
+            ReadErrors++;
+        return A2SimReadData;
+    }
+
+    if (!Read)
+    {
+        if (Address < 0xc000)
+            Memory[Address] = Data;
+        return 0;
+    }
+
+    if (Address == 0xc019)
+        return ((A2SimCycles % HARNESS_FRAME_CYCLES) < HARNESS_VBL_START) ? 0x80 : 0x00;
+    if ((Address & 0xf000) == 0xc000)
+        return 0x00; // other I/O: no key pressed, no other cards
+    return Memory[Address];
+}
+
+static uint8_t harnessRead(uint16_t Address)
+{
+    return harnessCycle(Address, true, 0);
+}
+
+static void harnessWrite(uint16_t Address, uint8_t Data)
+{
+    harnessCycle(Address, false, Data);
+}
+
+static void harnessReset(void)
+{
+    memset(Memory, 0, sizeof(Memory));
+    // monitor ROM: RTS everywhere, which is all the firmware may need ($FF58: IORTS)
+    memset(&Memory[0xd000], 0x60, 0x3000);
+    memcpy(&Memory[CALLCARD], CallCard, sizeof(CallCard));
+    Memory[CN]    = 0xc0 | Slot;
+    Memory[N0]    = Slot << 4;
+    Memory[TOCARD] = 0x4C; // JMP $0000, operand set by CALLCARD
+    Memory[TMP]   = 0x00;
+    Memory[TMP+1] = 0xc0 | Slot;
+
+    A2_INIT();
+    mouseControllerInit();
+    usb_core1_init();
+    usb_reset();
+
+    memset(&Cpu, 0, sizeof(Cpu));
+    Cpu.Read  = harnessRead;
+    Cpu.Write = harnessWrite;
+    cpu6502Reset(&Cpu);
+    Cpu.PC = CALLCARD_DONE;
+}
+
+/** Let the 6502 idle (in the stub's loop) for the given number of cycles, or until the IRQ line is asserted. */
+static bool harnessIdle(uint32_t Cycles, bool UntilIrq)
+{
+    uint64_t End = Cpu.Cycles + Cycles;
+    Cpu.PC = CALLCARD_DONE;
+    while (Cpu.Cycles < End)
+    {
+        if ((UntilIrq)&&(A2SimIrq))
+            return true;
+        cpu6502Step(&Cpu);
+    }
+    return !UntilIrq;
+}
+
+/** Call a firmware entry point. Returns false on errors (timeout, unsupported opcode or carry set). */
+static bool harnessCall(uint8_t Entry, uint8_t A)
+{
+    Cpu.PC = CALLCARD;
+    Cpu.A  = A;
+    Cpu.Y  = Entry;
+    Cpu.S  = 0xff;
+
+    uint64_t Start = 0;
+    uint64_t Timeout = Cpu.Cycles + HARNESS_TIMEOUT;
+    while ((Cpu.PC != CALLCARD_DONE)&&(Cpu.Cycles < Timeout)&&(!Cpu.Halted))
+    {
+        if (Cpu.PC == CALLCARD_JSR)
+            Start = Cpu.Cycles;
+        cpu6502Step(&Cpu);
+    }
+
+    const char* Name = HarnessEntryNames[Entry - HARNESS_SETMOUSE];
+    if (Cpu.PC != CALLCARD_DONE)
+    {
+        printf("ERROR: %s with A=%02X: %s at PC=%04X.\n", Name, A,
+               (Cpu.Halted) ? "unsupported opcode" : "timeout", Cpu.PC);
+        ResultErrors++;
+        return false;
+    }
+
+    uint32_t Cycles = Cpu.Cycles - Start;
+    THarnessStats* s = &HarnessStats[Entry - HARNESS_SETMOUSE];
+    if ((!s->Count)||(Cycles < s->Min))
+        s->Min = Cycles;
+    if (Cycles > s->Max)
+        s->Max = Cycles;
+    s->Total += Cycles;
+    s->Count++;
+
+    if (Verbose)
+        printf("%-10s A=%02X: %5u cycles, C=%u\n", Name, A, Cycles, Cpu.P & CPU6502_C);
+
+    if (Cpu.P & CPU6502_C)
+    {
+        printf("ERROR: %s with A=%02X returned with carry set.\n", Name, A);
+        ResultErrors++;
+        return false;
+    }
+    return true;
+}
+
+/** READMOUSE and verify the position and button state in the screen holes. */
+static void harnessReadMouse(int32_t X, int32_t Y, bool Button)
+{
+    if (!harnessCall(HARNESS_READMOUSE, 0x88))
+        return;
+    int32_t ReadX  = Memory[HOLE_XL+Slot] | (Memory[HOLE_XH+Slot] << 8);
+    int32_t ReadY  = Memory[HOLE_YL+Slot] | (Memory[HOLE_YH+Slot] << 8);
+    bool    Status = (Memory[HOLE_STATUS+Slot] & 0x80) != 0;
+    if ((ReadX != X)||(ReadY != Y)||(Status != Button))
+    {
+        if (ResultErrors < 10)
+            printf("ERROR: READMOUSE returned X=%d Y=%d B=%u, expected X=%d Y=%d B=%u.\n",
+                   ReadX, ReadY, Status, X, Y, Button);
+        ResultErrors++;
+    }
+}
+
+static void harnessSetHoles(uint16_t Base, uint16_t Low, uint16_t High, uint32_t Value)
+{
+    Memory[Low +Base] = Value & 0xff;
+    Memory[High+Base] = Value >> 8;
+}
+
+static int32_t harnessClamp(int32_t Value, int32_t Min, int32_t Max)
+{
+    return (Value < Min) ? Min : (Value > Max) ? Max : Value;
+}
+
+/** MOUSE.SAMPLE.asm-like sequence, plus the remaining firmware calls. */
+static void harnessRun(uint32_t Moves)
+{
+    int32_t  X = 0, Y = 0;
+    int32_t  MinX = 0, MaxX = 1023, MinY = 0, MaxY = 1023;
+    bool     Button = false;
+    uint32_t Random = 1;
+
+    harnessReset();
+    // positions are verified against 1:1 motion
+    mouseControllerAccel(false);
+
+    // signature bytes of the mouse firmware
+    if ((harnessRead((0xc000|(Slot<<8))+0x0c) != 0x20)||(harnessRead((0xc000|(Slot<<8))+0xfb) != 0xd6))
+    {
+        printf("ERROR: no mouse firmware in slot %u.\n", Slot);
+        ResultErrors++;
+        return;
+    }
+
+    harnessCall(HARNESS_INITMOUSE, 0x00);
+    harnessCall(HARNESS_SETMOUSE,  0x01); // passive mode
+
+    // move the mouse and read it, like the sample's main loop
+    for (uint32_t i=0;i<Moves;i++)
+    {
+        Random = Random*1103515245 + 12345;
+        int8_t dx = (int8_t)((Random >> 16) % 41) - 20;
+        int8_t dy = (int8_t)((Random >> 24) % 41) - 20;
+        mouseControllerReportTime(A2_TIMESTAMP());
+        mouseControllerMoveXY(dx, dy);
+        X = harnessClamp(X+dx, MinX, MaxX);
+        Y = harnessClamp(Y+dy, MinY, MaxY);
+        if ((i % 16) == 0)
+        {
+            Button = !Button;
+            mouseControllerUpdateButton(0, Button);
+        }
+        harnessIdle(100, false);
+        harnessReadMouse(X, Y, Button);
+    }
+
+    // POSMOUSE
+    X = 300; Y = 200;
+    harnessSetHoles(Slot, HOLE_XL, HOLE_XH, X);
+    harnessSetHoles(Slot, HOLE_YL, HOLE_YH, Y);
+    harnessCall(HARNESS_POSMOUSE, 0x00);
+    harnessReadMouse(X, Y, Button);
+
+    // CLAMPMOUSE (X: 100..500, Y: 50..400), HOMEMOUSE
+    MinX = 100; MaxX = 500;
+    harnessSetHoles(0, HOLE_XL, HOLE_XH, MinX);
+    harnessSetHoles(0, HOLE_YL, HOLE_YH, MaxX);
+    harnessCall(HARNESS_CLAMPMOUSE, 0x00);
+    MinY = 50; MaxY = 400;
+    harnessSetHoles(0, HOLE_XL, HOLE_XH, MinY);
+    harnessSetHoles(0, HOLE_YL, HOLE_YH, MaxY);
+    harnessCall(HARNESS_CLAMPMOUSE, 0x01);
+    harnessCall(HARNESS_HOMEMOUSE,  0x00);
+    X = MinX; Y = MinY;
+    harnessReadMouse(X, Y, Button);
+    for (uint32_t i=0;i<30;i++)
+    {
+        mouseControllerMoveXY(127, 127);
+        X = harnessClamp(X+127, MinX, MaxX);
+        Y = harnessClamp(Y+127, MinY, MaxY);
+    }
+    harnessReadMouse(X, Y, Button);
+
+    // CLEARMOUSE
+    harnessCall(HARNESS_CLEARMOUSE, 0x00);
+    harnessReadMouse(0, 0, Button);
+
+    // interrupt mode: mouse on, VBL interrupts
+    harnessCall(HARNESS_INITMOUSE, 0x00);
+    harnessCall(HARNESS_SETMOUSE,  0x09);
+    for (uint32_t i=0;i<Moves/10+1;i++)
+    {
+        if (!harnessIdle(3*HARNESS_FRAME_CYCLES, true))
+        {
+            printf("ERROR: no VBL interrupt.\n");
+            ResultErrors++;
+            break;
+        }
+        harnessCall(HARNESS_SERVEMOUSE, 0x00);
+        if ((Memory[HOLE_STATUS+Slot] & 0x08) == 0)
+        {
+            printf("ERROR: SERVEMOUSE did not report the VBL interrupt (status %02X).\n", Memory[HOLE_STATUS+Slot]);
+            ResultErrors++;
+        }
+        if (A2SimIrq)
+        {
+            printf("ERROR: IRQ still asserted after SERVEMOUSE.\n");
+            ResultErrors++;
+        }
+    }
+
+    harnessCall(HARNESS_SETMOUSE, 0x00); // off
+}
+
+static void harnessReport(void)
+{
+    printf("Slot %u, core0 every %u bus cycles\n", Slot, Core0Interval);
+    printf("%-12s %8s %8s %8s %8s\n", "Call", "Count", "min", "avg", "max");
+    for (uint32_t i=0;i<HARNESS_ENTRIES;i++)
+    {
+        THarnessStats* s = &HarnessStats[i];
+        if (!s->Count)
+            continue;
+        printf("%-12s %8u %8u %8.1f %8u\n", HarnessEntryNames[i], s->Count, s->Min,
+               ((double) s->Total)/s->Count, s->Max);
+    }
+    printf("(6502 cycles per call, including the JSR and RTS)\n");
+    if (MouseLatency.Count)
+    {
+        printf("Report to READMOUSE: %u reports, min %u, avg %u, p99 %u, max %u (bus cycles)\n",
+               MouseLatency.Count, MouseLatency.Min, latencyAverage(&MouseLatency),
+               latencyPercentile(&MouseLatency, 990), MouseLatency.Max);
+    }
+    if (ReadErrors)
+        printf("ERROR: %u read cycles without valid data.\n", ReadErrors);
+    if (ResultErrors)
+        printf("ERROR: %u unexpected firmware results.\n", ResultErrors);
+}
+
+static void usage(const char* Name)
+{
+    fprintf(stderr,
+            "Usage: %s [-v] [-s slot] [-n moves] [-c core0-interval]\n"
+            "  -v  print every firmware call\n"
+            "  -s  slot of the mouse card (1-7, default: 4)\n"
+            "  -n  number of mouse movements read with READMOUSE (default: 100)\n"
+            "  -c  number of bus cycles in between calls to core0's mouseControllerRun (default: 8)\n",
+            Name);
+}
+
+int main(int argc, char* argv[])
+{
+    uint32_t Moves = 100;
+    int      opt;
+
+    while ((opt = getopt(argc, argv, "vs:n:c:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'v': Verbose = true; break;
+            case 's': Slot    = strtoul(optarg, NULL, 0); break;
+            case 'n': Moves   = strtoul(optarg, NULL, 0); break;
+            case 'c': Core0Interval = strtoul(optarg, NULL, 0); break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if ((optind != argc)||(Slot < 1)||(Slot > 7)||(Core0Interval == 0))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    harnessRun(Moves);
+    harnessReport();
+
+    return (ReadErrors || ResultErrors) ? 2 : 0;
+}
@@ -0,0 +1,205 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2024 Thorsten Brehm
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/* a2hid.c: Host check of the report protocol mouse parser (source/usb/hid_mouse.c).
+
+   Parses the report descriptors of real devices and decodes a sample report
+   (without its report ID, as hid_app.c passes it) with the resulting layout:
+   report IDs, buttons declared by usage minimum/maximum, 12 and 16bit axes,
+   wheels, more report IDs than the parser tracks, and descriptors which must be
+   rejected (with an empty layout): keyboards, absolute pointers.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "usb/hid_mouse.h"
+
+typedef struct
+{
+    const char*    Name;
+    const uint8_t* Descriptor;
+    uint16_t       Length;
+    bool           Valid;     /**< expected result of the parser */
+    uint8_t        ReportId;
+    uint8_t        ReportLength;
+    const uint8_t* Report;    /**< sample report (without the report ID) */
+    int32_t        Buttons, X, Y, Wheel;
+} THidTest;
+
+/* Logitech Unifying receiver, mouse interface: report ID 2, 16 buttons, 12bit X/Y, wheel, AC pan */
+static const uint8_t LogitechUnifying[] =
+{
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x85, 0x02, 0x09, 0x01, 0xA1, 0x00,
+    0x05, 0x09, 0x19, 0x01, 0x29, 0x10, 0x15, 0x00, 0x25, 0x01, 0x95, 0x10, 0x75, 0x01, 0x81, 0x02,
+    0x05, 0x01, 0x16, 0x01, 0xF8, 0x26, 0xFF, 0x07, 0x75, 0x0C, 0x95, 0x02, 0x09, 0x30, 0x09, 0x31, 0x81, 0x06,
+    0x15, 0x81, 0x25, 0x7F, 0x75, 0x08, 0x95, 0x01, 0x09, 0x38, 0x81, 0x06,
+    0x05, 0x0C, 0x0A, 0x38, 0x02, 0x95, 0x01, 0x81, 0x06,
+    0xC0, 0xC0
+};
+/* buttons 1+3, X=-3, Y=+5, wheel -1, pan 0 */
+static const uint8_t LogitechReport[] = { 0x05, 0x00, 0xFD, 0x5F, 0x00, 0xFF, 0x00 };
+
+/* Gaming mouse: no report ID, 5 buttons and padding, 16bit X/Y, wheel */
+static const uint8_t Gaming16Bit[] =
+{
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x09, 0x01, 0xA1, 0x00,
+    0x05, 0x09, 0x19, 0x01, 0x29, 0x05, 0x15, 0x00, 0x25, 0x01, 0x95, 0x05, 0x75, 0x01, 0x81, 0x02,
+    0x95, 0x01, 0x75, 0x03, 0x81, 0x01,
+    0x05, 0x01, 0x09, 0x30, 0x09, 0x31, 0x16, 0x01, 0x80, 0x26, 0xFF, 0x7F, 0x75, 0x10, 0x95, 0x02, 0x81, 0x06,
+    0x09, 0x38, 0x15, 0x81, 0x25, 0x7F, 0x75, 0x08, 0x95, 0x01, 0x81, 0x06,
+    0xC0, 0xC0
+};
+/* buttons 1+5, X=-1000, Y=+1234, wheel +1 */
+static const uint8_t GamingReport[] = { 0x11, 0x18, 0xFC, 0xD2, 0x04, 0x01 };
+
+/* HID 1.11, appendix E.10: 3 buttons, 8bit X/Y (the boot protocol layout) */
+static const uint8_t HidSpecMouse[] =
+{
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x09, 0x01, 0xA1, 0x00,
+    0x05, 0x09, 0x19, 0x01, 0x29, 0x03, 0x15, 0x00, 0x25, 0x01, 0x95, 0x03, 0x75, 0x01, 0x81, 0x02,
+    0x95, 0x01, 0x75, 0x05, 0x81, 0x01,
+    0x05, 0x01, 0x09, 0x30, 0x09, 0x31, 0x15, 0x81, 0x25, 0x7F, 0x75, 0x08, 0x95, 0x02, 0x81, 0x06,
+    0xC0, 0xC0
+};
+/* button 2, X=+127, Y=-128 */
+static const uint8_t HidSpecReport[] = { 0x02, 0x7F, 0x80 };
+
+/* Keyboard (report ID 1) and mouse (report ID 2) on one interface, as wireless combo receivers do */
+#define KEYBOARD_DESCRIPTOR \
+    0x05, 0x01, 0x09, 0x06, 0xA1, 0x01, 0x85, 0x01, \
+    0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7, 0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02, \
+    0x95, 0x01, 0x75, 0x08, 0x81, 0x01, \
+    0x95, 0x06, 0x75, 0x08, 0x15, 0x00, 0x25, 0x65, 0x05, 0x07, 0x19, 0x00, 0x29, 0x65, 0x81, 0x00, \
+    0xC0
+static const uint8_t ComboReceiver[] =
+{
+    KEYBOARD_DESCRIPTOR,
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x85, 0x02, 0x09, 0x01, 0xA1, 0x00,
+    0x05, 0x09, 0x19, 0x01, 0x29, 0x03, 0x15, 0x00, 0x25, 0x01, 0x95, 0x03, 0x75, 0x01, 0x81, 0x02,
+    0x95, 0x01, 0x75, 0x05, 0x81, 0x01,
+    0x05, 0x01, 0x09, 0x30, 0x09, 0x31, 0x09, 0x38, 0x15, 0x81, 0x25, 0x7F, 0x75, 0x08, 0x95, 0x03, 0x81, 0x06,
+    0xC0, 0xC0
+};
+/* buttons 1-3, X=-1, Y=+1, wheel -2 */
+static const uint8_t ComboReport[] = { 0x07, 0xFF, 0x01, 0xFE };
+
+/* Keyboard only: rejected */
+static const uint8_t Keyboard[] = { KEYBOARD_DESCRIPTOR };
+
+/* Vendor defined input report (one byte) with the given report ID */
+#define VENDOR_REPORT(Id) \
+    0x85, Id, 0x09, 0x01, 0x15, 0x00, 0x26, 0xFF, 0x00, 0x75, 0x08, 0x95, 0x01, 0x81, 0x02
+#define HID_SPEC_MOUSE(Id) \
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x85, Id, 0x09, 0x01, 0xA1, 0x00, \
+    0x05, 0x09, 0x19, 0x01, 0x29, 0x03, 0x15, 0x00, 0x25, 0x01, 0x95, 0x03, 0x75, 0x01, 0x81, 0x02, \
+    0x95, 0x01, 0x75, 0x05, 0x81, 0x01, \
+    0x05, 0x01, 0x09, 0x30, 0x09, 0x31, 0x15, 0x81, 0x25, 0x7F, 0x75, 0x08, 0x95, 0x02, 0x81, 0x06, \
+    0xC0, 0xC0
+
+/* More report IDs than the parser tracks, mouse first (report ID 1): the mouse is still found */
+static const uint8_t ManyReportsMouseFirst[] =
+{
+    HID_SPEC_MOUSE(0x01),
+    0x06, 0x00, 0xFF, 0x09, 0x01, 0xA1, 0x01,
+    VENDOR_REPORT(0x02), VENDOR_REPORT(0x03), VENDOR_REPORT(0x04), VENDOR_REPORT(0x05),
+    VENDOR_REPORT(0x06), VENDOR_REPORT(0x07), VENDOR_REPORT(0x08), VENDOR_REPORT(0x09),
+    0xC0
+};
+
+/* More report IDs than the parser tracks, mouse last (report ID 9): its bit positions are unknown, rejected */
+static const uint8_t ManyReportsMouseLast[] =
+{
+    0x06, 0x00, 0xFF, 0x09, 0x01, 0xA1, 0x01,
+    VENDOR_REPORT(0x01), VENDOR_REPORT(0x02), VENDOR_REPORT(0x03), VENDOR_REPORT(0x04),
+    VENDOR_REPORT(0x05), VENDOR_REPORT(0x06), VENDOR_REPORT(0x07), VENDOR_REPORT(0x08),
+    0xC0,
+    HID_SPEC_MOUSE(0x09)
+};
+
+/* Graphics tablet: absolute X/Y, rejected */
+static const uint8_t Tablet[] =
+{
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x09, 0x01, 0xA1, 0x00,
+    0x05, 0x09, 0x19, 0x01, 0x29, 0x02, 0x15, 0x00, 0x25, 0x01, 0x95, 0x02, 0x75, 0x01, 0x81, 0x02,
+    0x95, 0x06, 0x81, 0x01,
+    0x05, 0x01, 0x09, 0x30, 0x09, 0x31, 0x15, 0x00, 0x26, 0xFF, 0x7F, 0x75, 0x10, 0x95, 0x02, 0x81, 0x02,
+    0xC0, 0xC0
+};
+
+#define HID_TEST(Descriptor) #Descriptor, Descriptor, sizeof(Descriptor)
+
+static const THidTest HidTests[] =
+{
+    { HID_TEST(LogitechUnifying), true,  2, 6, LogitechReport, 0x05,    -3,    5, -1 },
+    { HID_TEST(Gaming16Bit),      true,  0, 6, GamingReport,   0x11, -1000, 1234,  1 },
+    { HID_TEST(HidSpecMouse),     true,  0, 3, HidSpecReport,  0x02,   127, -128,  0 },
+    { HID_TEST(ComboReceiver),    true,  2, 4, ComboReport,    0x07,    -1,    1, -2 },
+    { HID_TEST(ManyReportsMouseFirst), true, 1, 3, HidSpecReport, 0x02, 127, -128,  0 },
+    { HID_TEST(ManyReportsMouseLast),  false, 0, 0, NULL,         0,      0,    0,  0 },
+    { HID_TEST(Keyboard),         false, 0, 0, NULL,           0,        0,    0,  0 },
+    { HID_TEST(Tablet),           false, 0, 0, NULL,           0,        0,    0,  0 },
+};
+
+static bool hidCheck(const char* Name, const char* What, int32_t Value, int32_t Expected)
+{
+    if (Value == Expected)
+        return true;
+    printf("ERROR: %s: %s is %d, expected %d.\n", Name, What, Value, Expected);
+    return false;
+}
+
+int main(void)
+{
+    uint32_t Errors = 0;
+
+    for (uint32_t i=0;i<sizeof(HidTests)/sizeof(HidTests[0]);i++)
+    {
+        const THidTest* t = &HidTests[i];
+        THidMouseLayout Layout;
+        bool Valid = hidMouseParseDescriptor(&Layout, t->Descriptor, t->Length);
+        bool Ok = hidCheck(t->Name, "valid", Valid, t->Valid);
+        if ((Ok)&&(Valid))
+        {
+            Ok &= hidCheck(t->Name, "report ID", Layout.ReportId, t->ReportId);
+            Ok &= hidCheck(t->Name, "report length", Layout.Length, t->ReportLength);
+            if (Ok)
+            {
+                Ok &= hidCheck(t->Name, "buttons", hidFieldGet(&Layout.Buttons, t->Report), t->Buttons);
+                Ok &= hidCheck(t->Name, "X", hidFieldGet(&Layout.X, t->Report), t->X);
+                Ok &= hidCheck(t->Name, "Y", hidFieldGet(&Layout.Y, t->Report), t->Y);
+                Ok &= hidCheck(t->Name, "wheel", hidFieldGet(&Layout.Wheel, t->Report), t->Wheel);
+            }
+        }
+        else
+        if (Ok)
+            Ok &= hidCheck(t->Name, "report length", Layout.Length, 0);
+        printf("%-22s %s\n", t->Name, (Ok) ? "ok" : "FAILED");
+        if (!Ok)
+            Errors++;
+    }
+    return (Errors) ? 2 : 0;
+}
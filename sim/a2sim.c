@@ -0,0 +1,387 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2024 Thorsten Brehm
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/* a2sim.c: Host-side bus cycle simulator.
+
+   Replays recorded 6502 bus cycles (in the 32bit PIO message format) through the
+   same core1 bus interface code which runs on the PICO (usb_buscycle, usb_busread,
+   usb_buswrite), with the PIA and MouseInterfaceCard emulation. The core0 part
+   (mouseControllerRun) is called in between bus cycles at a fixed interval, so
+   results are deterministic.
+
+   Reports the number of bus events and the cost per event, separately for each bus
+   interface path. The cost is the number of basic blocks executed by the simulated
+   path (the build instruments the code with -fsanitize-coverage=trace-pc), so it is
+   deterministic for a given build and trace. The host execution time is reported as
+   additional information only: it depends on the host's load and does not match the
+   RP2040.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "a2platform.h"
+#include "usb/usb.h"
+#include "usb/businterface.c"
+
+/* Bus interface paths, which are measured separately */
+enum
+{
+    SIM_PATH_DEVSEL_READ = 0,
+    SIM_PATH_DEVSEL_WRITE,
+    SIM_PATH_IOSEL_READ,
+    SIM_PATH_IOSEL_WRITE,
+    SIM_PATH_IDLE,
+    SIM_PATH_COUNT
+};
+
+static const char* SimPathNames[SIM_PATH_COUNT] =
+{
+    "DEVSEL read",
+    "DEVSEL write",
+    "IOSEL read",
+    "IOSEL write",
+    "not selected"
+};
+
+typedef struct
+{
+    uint64_t Count;
+    uint64_t TotalBlocks;
+    uint64_t MaxBlocks;
+    uint64_t TotalNs;
+    uint64_t MaxNs;
+} TSimPathStats;
+
+static TSimPathStats SimStats[SIM_PATH_COUNT];
+
+/* Bus cycle input */
+static uint32_t* Trace       = NULL;
+static uint32_t  TraceLength = 0;
+static uint32_t  TracePos    = 0;
+
+/* Errors: read cycles without (or with multiple) data bytes for the 6502 */
+static uint32_t  ReadErrors  = 0;
+/* Errors: precomputed PIA read image not matching the actual PIA state */
+static uint32_t  ImageErrors = 0;
+
+/* Basic blocks executed so far (by all instrumented code) */
+static uint64_t  SimBlocks   = 0;
+
+/** Called by the coverage instrumentation at the start of every basic block. */
+#ifdef __clang__
+__attribute__((no_sanitize("coverage")))
+#else
+__attribute__((no_sanitize_coverage))
+#endif
+void __sanitizer_cov_trace_pc(void)
+{
+    SimBlocks++;
+}
+
+uint32_t A2SimNextCycle(void)
+{
+    A2SIM_VBL_CYCLE();
+    return Trace[TracePos++];
+}
+
+static void traceAppend(uint32_t value, uint32_t* Capacity)
+{
+    if (TraceLength >= *Capacity)
+    {
+        *Capacity = (*Capacity) ? (*Capacity)*2 : 4096;
+        Trace = realloc(Trace, (*Capacity)*sizeof(uint32_t));
+        if (!Trace)
+        {
+            fprintf(stderr, "Out of memory.\n");
+            exit(1);
+        }
+    }
+    Trace[TraceLength++] = value;
+}
+
+/** Load a bus cycle trace: text (one hex word per cycle, '#' comments) or binary (little-endian 32bit words). */
+static bool traceLoad(const char* FileName, bool Binary)
+{
+    uint32_t Capacity = 0;
+    FILE* f = fopen(FileName, (Binary) ? "rb" : "r");
+    if (!f)
+    {
+        fprintf(stderr, "Cannot open trace file '%s'.\n", FileName);
+        return false;
+    }
+
+    if (Binary)
+    {
+        uint8_t w[4];
+        while (fread(w, 1, 4, f) == 4)
+            traceAppend(w[0] | (w[1]<<8) | (w[2]<<16) | ((uint32_t)w[3]<<24), &Capacity);
+    }
+    else
+    {
+        char Line[256];
+        uint32_t LineNr = 0;
+        while (fgets(Line, sizeof(Line), f))
+        {
+            LineNr++;
+            char* Comment = strchr(Line, '#');
+            if (Comment)
+                *Comment = 0;
+            char* Token = strtok(Line, " \t\r\n");
+            while (Token)
+            {
+                char* End;
+                uint32_t value = strtoul(Token, &End, 16);
+                if (*End)
+                {
+                    fprintf(stderr, "%s:%u: invalid bus cycle '%s'.\n", FileName, LineNr, Token);
+                    fclose(f);
+                    return false;
+                }
+                traceAppend(value, &Capacity);
+                Token = strtok(NULL, " \t\r\n");
+            }
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+static inline uint64_t simNanoseconds(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return ((uint64_t) t.tv_sec)*1000000000ull + t.tv_nsec;
+}
+
+/** Measure the overhead of the time measurement itself. */
+static uint64_t simTimerOverhead(void)
+{
+    uint64_t Min = ~0ull;
+    for (int i=0;i<10000;i++)
+    {
+        uint64_t t0 = simNanoseconds();
+        uint64_t t1 = simNanoseconds();
+        if (t1-t0 < Min)
+            Min = t1-t0;
+    }
+    return Min;
+}
+
+static inline uint32_t simPath(uint32_t value, uint32_t address)
+{
+    if (!A2_IS_SELECT(address))
+        return SIM_PATH_IDLE;
+    if (A2_IS_DEVSEL(address))
+        return (A2_IS_ACCESS_READ(value)) ? SIM_PATH_DEVSEL_READ : SIM_PATH_DEVSEL_WRITE;
+    return (A2_IS_ACCESS_READ(value)) ? SIM_PATH_IOSEL_READ : SIM_PATH_IOSEL_WRITE;
+}
+
+/** Verify the PIA read image against the PIA register state. */
+static inline void simCheckImage(uint32_t CycleNr)
+{
+    for (uint32_t i=0;i<4;i++)
+    {
+        if (Pia.ReadImage[i] != PIA6520_read(i))
+        {
+            if (!ImageErrors)
+                printf("%8u: PIA read image mismatch: register %u is %02X, expected %02X\n",
+                       CycleNr, i, Pia.ReadImage[i], PIA6520_read(i));
+            ImageErrors++;
+        }
+    }
+}
+
+/** The bus interface path, kept out of line: otherwise its branches merge with simPath's and are counted outside the measurement. */
+static __attribute__((noinline)) void simBusCycle(uint32_t value, uint32_t address)
+{
+    usb_buscycle(value, address);
+}
+
+static void simReset(void)
+{
+    A2_INIT();
+    mouseControllerInit();
+    usb_core1_init();
+    usb_reset();
+}
+
+/** Replay the trace once. */
+static void simRun(uint64_t TimerOverhead, uint32_t Core0Interval, bool Verbose)
+{
+    uint32_t CycleNr = 0;
+    uint32_t VblEvents = 0;
+
+    simReset();
+
+    for (TracePos = 0; TracePos < TraceLength;)
+    {
+        uint32_t value, address;
+
+        // wait for next "PIO" event
+        A2_GETADDRESS(value, address);
+
+        uint32_t Path = simPath(value, address);
+        A2SimReadCount = 0;
+
+        uint64_t t0 = simNanoseconds();
+        uint64_t b0 = SimBlocks;
+        simBusCycle(value, address);
+        uint64_t b1 = SimBlocks;
+        uint64_t t1 = simNanoseconds();
+
+        uint64_t Blocks = b1-b0;
+        SimStats[Path].TotalBlocks += Blocks;
+        if (Blocks > SimStats[Path].MaxBlocks)
+            SimStats[Path].MaxBlocks = Blocks;
+
+        uint64_t Ns = t1-t0;
+        Ns = (Ns > TimerOverhead) ? Ns-TimerOverhead : 0;
+        SimStats[Path].Count++;
+        SimStats[Path].TotalNs += Ns;
+        if (Ns > SimStats[Path].MaxNs)
+            SimStats[Path].MaxNs = Ns;
+
+        if (((Path == SIM_PATH_DEVSEL_READ)||(Path == SIM_PATH_IOSEL_READ))&&
+            (A2SimReadCount != 1))
+        {
+            ReadErrors++;
+        }
+
+        if (Verbose)
+        {
+            switch (Path)
+            {
+                case SIM_PATH_DEVSEL_READ:
+                case SIM_PATH_IOSEL_READ:
+                    printf("%8u: R %04X -> %02X  IRQ=%u\n", CycleNr, address, A2SimReadData & 0xff, A2SimIrq);
+                    break;
+                case SIM_PATH_DEVSEL_WRITE:
+                case SIM_PATH_IOSEL_WRITE:
+                    printf("%8u: W %04X <- %02X  IRQ=%u\n", CycleNr, address, value & 0xff, A2SimIrq);
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        // give core0 a chance to process the PIA state
+        if (++CycleNr % Core0Interval == 0)
+            mouseControllerRun();
+
+        simCheckImage(CycleNr);
+
+        if ((Verbose)&&(A2SimVblEvents != VblEvents))
+        {
+            VblEvents = A2SimVblEvents;
+            printf("%8u: VBL\n", CycleNr);
+        }
+    }
+}
+
+static void simReport(uint32_t Repeat)
+{
+    printf("Bus cycles: %u (x%u)\n", TraceLength, Repeat);
+    printf("%-14s %10s %12s %12s %10s %10s\n", "Path", "Events", "avg[blocks]", "max[blocks]", "avg[ns]", "max[ns]");
+    for (uint32_t i=0;i<SIM_PATH_COUNT;i++)
+    {
+        TSimPathStats* s = &SimStats[i];
+        if (!s->Count)
+            continue;
+        printf("%-14s %10llu %12.2f %12llu %10.1f %10llu\n", SimPathNames[i],
+               (unsigned long long) s->Count,
+               ((double) s->TotalBlocks)/s->Count,
+               (unsigned long long) s->MaxBlocks,
+               ((double) s->TotalNs)/s->Count,
+               (unsigned long long) s->MaxNs);
+    }
+    if (ReadErrors)
+        printf("ERROR: %u read cycles without valid data.\n", ReadErrors);
+    if (ImageErrors)
+        printf("ERROR: %u PIA read image mismatches.\n", ImageErrors);
+}
+
+static void usage(const char* Name)
+{
+    fprintf(stderr,
+            "Usage: %s [-b] [-v] [-p] [-k bus-clock] [-n repeat] [-c core0-interval] trace\n"
+            "  -b  trace is binary (little-endian 32bit words), otherwise text (hex words)\n"
+            "  -v  print all bus cycles addressing the card (only for the first run)\n"
+            "  -p  simulate the bus clock of a PAL machine (default: NTSC)\n"
+            "  -k  simulated bus clock in Hz (e.g. a bus which isn't in sync with the video)\n"
+            "  -n  number of times the trace is replayed (default: 100)\n"
+            "  -c  number of bus cycles in between calls to core0's mouseControllerRun (default: 8)\n",
+            Name);
+}
+
+int main(int argc, char* argv[])
+{
+    bool     Binary        = false;
+    bool     Verbose       = false;
+    uint32_t Repeat        = 100;
+    uint32_t Core0Interval = 8;
+    int      opt;
+
+    while ((opt = getopt(argc, argv, "bvpk:n:c:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'b': Binary  = true; break;
+            case 'v': Verbose = true; break;
+            case 'p': A2SimBusClock = A2SIM_BUSCLOCK_PAL; break;
+            case 'k': A2SimBusClock = strtoul(optarg, NULL, 0); break;
+            case 'n': Repeat  = strtoul(optarg, NULL, 0); break;
+            case 'c': Core0Interval = strtoul(optarg, NULL, 0); break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if ((optind+1 != argc)||(Repeat == 0)||(Core0Interval == 0)||(A2SimBusClock == 0))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (!traceLoad(argv[optind], Binary))
+        return 1;
+
+    uint64_t TimerOverhead = simTimerOverhead();
+    for (uint32_t i=0;i<Repeat;i++)
+    {
+        simRun(TimerOverhead, Core0Interval, Verbose && (i==0));
+        if (ReadErrors || ImageErrors)
+            break;
+    }
+
+    simReport(Repeat);
+
+    free(Trace);
+    return (ReadErrors || ImageErrors) ? 2 : 0;
+}
@@ -0,0 +1,51 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2024 Thorsten Brehm
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/* a2simstate.c: State of the simulated platform (lib/a2sim/a2sim.h), shared by the host tools. */
+
+#include "a2platform.h"
+
+/* Simulated platform state */
+volatile uint32_t A2SimVblEvents;
+uint32_t A2SimVblCounter;
+uint32_t A2SimVblPeriod;
+uint32_t A2SimVblFifo[4];
+uint32_t A2SimVblFifoLevel;
+uint32_t A2SimVblPeriodFixed;
+uint32_t A2SimVblFraction;
+int32_t  A2SimVblAdjust;
+uint32_t A2SimVblTime;
+uint32_t A2SimVblInterval;
+uint32_t A2SimVblCycles;
+bool     A2SimVblRestarted;
+uint32_t A2SimVblTimerClock;
+uint32_t A2SimVblTimePerCycle;
+uint64_t A2SimVblAlarm;
+uint32_t A2SimCycles;
+uint32_t A2SimBusClock = A2SIM_BUSCLOCK_NTSC;
+uint32_t A2SimReadData;
+uint32_t A2SimReadCount;
+uint32_t A2SimIrq;
+uint8_t  A2SimResetState;
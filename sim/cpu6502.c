@@ -0,0 +1,460 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2024 Thorsten Brehm
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/* cpu6502.c: Minimal NMOS 6502 core for the host harness (see cpu6502.h). */
+
+#include "cpu6502.h"
+
+/* Addressing modes */
+enum
+{
+    AM_IMP = 0, AM_ACC, AM_IMM, AM_ZP, AM_ZPX, AM_ZPY, AM_ABS, AM_ABX, AM_ABY, AM_IZX, AM_IZY, AM_REL, AM_IND
+};
+
+/* Operations (OP_NONE: unsupported opcode) */
+enum
+{
+    OP_NONE = 0,
+    OP_ADC, OP_AND, OP_ASL, OP_BCC, OP_BCS, OP_BEQ, OP_BIT, OP_BMI, OP_BNE, OP_BPL, OP_BRK, OP_BVC, OP_BVS,
+    OP_CLC, OP_CLD, OP_CLI, OP_CLV, OP_CMP, OP_CPX, OP_CPY, OP_DEC, OP_DEX, OP_DEY, OP_EOR, OP_INC, OP_INX,
+    OP_INY, OP_JMP, OP_JSR, OP_LDA, OP_LDX, OP_LDY, OP_LSR, OP_NOP, OP_ORA, OP_PHA, OP_PHP, OP_PLA, OP_PLP,
+    OP_ROL, OP_ROR, OP_RTI, OP_RTS, OP_SBC, OP_SEC, OP_SED, OP_SEI, OP_STA, OP_STX, OP_STY, OP_TAX, OP_TAY,
+    OP_TSX, OP_TXA, OP_TXS, OP_TYA
+};
+
+/* Kind of the final data access, which decides about the dummy cycles of indexed modes */
+enum
+{
+    ACCESS_READ = 0, ACCESS_WRITE, ACCESS_RMW
+};
+
+typedef struct
+{
+    uint8_t Op;
+    uint8_t Mode;
+} TOpcode;
+
+#define ALU(op, base) \
+    [base+0x09] = {op, AM_IMM}, [base+0x05] = {op, AM_ZP},  [base+0x15] = {op, AM_ZPX}, [base+0x0D] = {op, AM_ABS}, \
+    [base+0x1D] = {op, AM_ABX}, [base+0x19] = {op, AM_ABY}, [base+0x01] = {op, AM_IZX}, [base+0x11] = {op, AM_IZY}
+
+#define SHIFT(op, base) \
+    [base+0x0A] = {op, AM_ACC}, [base+0x06] = {op, AM_ZP},  [base+0x16] = {op, AM_ZPX}, [base+0x0E] = {op, AM_ABS}, \
+    [base+0x1E] = {op, AM_ABX}
+
+static const TOpcode Opcodes[256] =
+{
+    ALU(OP_ORA, 0x00), ALU(OP_AND, 0x20), ALU(OP_EOR, 0x40), ALU(OP_ADC, 0x60),
+    ALU(OP_LDA, 0xA0), ALU(OP_CMP, 0xC0), ALU(OP_SBC, 0xE0),
+    [0x85] = {OP_STA, AM_ZP},  [0x95] = {OP_STA, AM_ZPX}, [0x8D] = {OP_STA, AM_ABS}, [0x9D] = {OP_STA, AM_ABX},
+    [0x99] = {OP_STA, AM_ABY}, [0x81] = {OP_STA, AM_IZX}, [0x91] = {OP_STA, AM_IZY},
+
+    SHIFT(OP_ASL, 0x00), SHIFT(OP_ROL, 0x20), SHIFT(OP_LSR, 0x40), SHIFT(OP_ROR, 0x60),
+    [0xC6] = {OP_DEC, AM_ZP},  [0xD6] = {OP_DEC, AM_ZPX}, [0xCE] = {OP_DEC, AM_ABS}, [0xDE] = {OP_DEC, AM_ABX},
+    [0xE6] = {OP_INC, AM_ZP},  [0xF6] = {OP_INC, AM_ZPX}, [0xEE] = {OP_INC, AM_ABS}, [0xFE] = {OP_INC, AM_ABX},
+
+    [0xA2] = {OP_LDX, AM_IMM}, [0xA6] = {OP_LDX, AM_ZP},  [0xB6] = {OP_LDX, AM_ZPY}, [0xAE] = {OP_LDX, AM_ABS},
+    [0xBE] = {OP_LDX, AM_ABY},
+    [0xA0] = {OP_LDY, AM_IMM}, [0xA4] = {OP_LDY, AM_ZP},  [0xB4] = {OP_LDY, AM_ZPX}, [0xAC] = {OP_LDY, AM_ABS},
+    [0xBC] = {OP_LDY, AM_ABX},
+    [0x86] = {OP_STX, AM_ZP},  [0x96] = {OP_STX, AM_ZPY}, [0x8E] = {OP_STX, AM_ABS},
+    [0x84] = {OP_STY, AM_ZP},  [0x94] = {OP_STY, AM_ZPX}, [0x8C] = {OP_STY, AM_ABS},
+    [0xE0] = {OP_CPX, AM_IMM}, [0xE4] = {OP_CPX, AM_ZP},  [0xEC] = {OP_CPX, AM_ABS},
+    [0xC0] = {OP_CPY, AM_IMM}, [0xC4] = {OP_CPY, AM_ZP},  [0xCC] = {OP_CPY, AM_ABS},
+    [0x24] = {OP_BIT, AM_ZP},  [0x2C] = {OP_BIT, AM_ABS},
+
+    [0x10] = {OP_BPL, AM_REL}, [0x30] = {OP_BMI, AM_REL}, [0x50] = {OP_BVC, AM_REL}, [0x70] = {OP_BVS, AM_REL},
+    [0x90] = {OP_BCC, AM_REL}, [0xB0] = {OP_BCS, AM_REL}, [0xD0] = {OP_BNE, AM_REL}, [0xF0] = {OP_BEQ, AM_REL},
+
+    [0x00] = {OP_BRK, AM_IMP}, [0x20] = {OP_JSR, AM_ABS}, [0x40] = {OP_RTI, AM_IMP}, [0x60] = {OP_RTS, AM_IMP},
+    [0x4C] = {OP_JMP, AM_ABS}, [0x6C] = {OP_JMP, AM_IND},
+    [0x08] = {OP_PHP, AM_IMP}, [0x28] = {OP_PLP, AM_IMP}, [0x48] = {OP_PHA, AM_IMP}, [0x68] = {OP_PLA, AM_IMP},
+    [0x18] = {OP_CLC, AM_IMP}, [0x38] = {OP_SEC, AM_IMP}, [0x58] = {OP_CLI, AM_IMP}, [0x78] = {OP_SEI, AM_IMP},
+    [0xB8] = {OP_CLV, AM_IMP}, [0xD8] = {OP_CLD, AM_IMP}, [0xF8] = {OP_SED, AM_IMP},
+    [0xAA] = {OP_TAX, AM_IMP}, [0x8A] = {OP_TXA, AM_IMP}, [0xA8] = {OP_TAY, AM_IMP}, [0x98] = {OP_TYA, AM_IMP},
+    [0xBA] = {OP_TSX, AM_IMP}, [0x9A] = {OP_TXS, AM_IMP},
+    [0xCA] = {OP_DEX, AM_IMP}, [0x88] = {OP_DEY, AM_IMP}, [0xE8] = {OP_INX, AM_IMP}, [0xC8] = {OP_INY, AM_IMP},
+    [0xEA] = {OP_NOP, AM_IMP},
+};
+
+static inline uint8_t cpuRead(TCpu6502* Cpu, uint16_t Address)
+{
+    Cpu->Cycles++;
+    return Cpu->Read(Address);
+}
+
+static inline void cpuWrite(TCpu6502* Cpu, uint16_t Address, uint8_t Data)
+{
+    Cpu->Cycles++;
+    Cpu->Write(Address, Data);
+}
+
+static inline uint8_t cpuFetch(TCpu6502* Cpu)
+{
+    return cpuRead(Cpu, Cpu->PC++);
+}
+
+static inline void cpuPush(TCpu6502* Cpu, uint8_t Data)
+{
+    cpuWrite(Cpu, 0x100 | Cpu->S--, Data);
+}
+
+static inline uint8_t cpuPull(TCpu6502* Cpu)
+{
+    return cpuRead(Cpu, 0x100 | ++Cpu->S);
+}
+
+static inline uint8_t cpuNZ(TCpu6502* Cpu, uint8_t Value)
+{
+    Cpu->P = (Cpu->P & ~(CPU6502_N|CPU6502_Z)) | (Value & CPU6502_N) | ((Value) ? 0 : CPU6502_Z);
+    return Value;
+}
+
+static inline void cpuFlag(TCpu6502* Cpu, uint8_t Flag, bool Set)
+{
+    Cpu->P = (Set) ? (Cpu->P | Flag) : (Cpu->P & ~Flag);
+}
+
+/** Run the addressing cycles up to the final data access. Returns the effective address. */
+static uint16_t cpuAddress(TCpu6502* Cpu, uint8_t Mode, uint8_t Access)
+{
+    uint16_t Base, Address;
+    uint8_t  Zp, Index;
+
+    switch (Mode)
+    {
+        case AM_IMM:
+            return Cpu->PC++;
+        case AM_ZP:
+            return cpuFetch(Cpu);
+        case AM_ZPX:
+        case AM_ZPY:
+            Zp = cpuFetch(Cpu);
+            cpuRead(Cpu, Zp); // dummy read, while adding the index
+            return (uint8_t)(Zp + ((Mode == AM_ZPX) ? Cpu->X : Cpu->Y));
+        case AM_ABS:
+            Address  = cpuFetch(Cpu);
+            Address |= cpuFetch(Cpu) << 8;
+            return Address;
+        case AM_IZX:
+            Zp = cpuFetch(Cpu);
+            cpuRead(Cpu, Zp); // dummy read, while adding the index
+            Zp += Cpu->X;
+            Address  = cpuRead(Cpu, Zp);
+            Address |= cpuRead(Cpu, (uint8_t)(Zp+1)) << 8;
+            return Address;
+        case AM_ABX:
+        case AM_ABY:
+        case AM_IZY:
+            if (Mode == AM_IZY)
+            {
+                Zp    = cpuFetch(Cpu);
+                Base  = cpuRead(Cpu, Zp);
+                Base |= cpuRead(Cpu, (uint8_t)(Zp+1)) << 8;
+            }
+            else
+            {
+                Base  = cpuFetch(Cpu);
+                Base |= cpuFetch(Cpu) << 8;
+            }
+            Index   = (Mode == AM_ABX) ? Cpu->X : Cpu->Y;
+            Address = Base + Index;
+            // dummy read with the uncorrected high byte: always for writes, only on page crossings for reads
+            if ((Access != ACCESS_READ)||((Base ^ Address) & 0xff00))
+                cpuRead(Cpu, (Base & 0xff00) | (Address & 0xff));
+            return Address;
+        default:
+            return 0;
+    }
+}
+
+static void cpuAdc(TCpu6502* Cpu, uint8_t Value)
+{
+    uint32_t Carry = Cpu->P & CPU6502_C;
+    if (Cpu->P & CPU6502_D)
+    {
+        // NMOS decimal mode: N/V from the intermediate result, Z from the binary sum
+        uint32_t Lo = (Cpu->A & 0x0f) + (Value & 0x0f) + Carry;
+        uint32_t Hi = (Cpu->A & 0xf0) + (Value & 0xf0);
+        if (Lo > 0x09)
+        {
+            Lo += 0x06;
+            Hi += 0x10;
+        }
+        cpuFlag(Cpu, CPU6502_Z, ((Cpu->A + Value + Carry) & 0xff) == 0);
+        cpuFlag(Cpu, CPU6502_N, Hi & 0x80);
+        cpuFlag(Cpu, CPU6502_V, (~(Cpu->A ^ Value) & (Cpu->A ^ Hi) & 0x80) != 0);
+        if (Hi > 0x90)
+            Hi += 0x60;
+        cpuFlag(Cpu, CPU6502_C, Hi > 0xff);
+        Cpu->A = (Lo & 0x0f) | (Hi & 0xf0);
+    }
+    else
+    {
+        uint32_t Sum = Cpu->A + Value + Carry;
+        cpuFlag(Cpu, CPU6502_V, (~(Cpu->A ^ Value) & (Cpu->A ^ Sum) & 0x80) != 0);
+        cpuFlag(Cpu, CPU6502_C, Sum > 0xff);
+        Cpu->A = cpuNZ(Cpu, Sum);
+    }
+}
+
+static void cpuSbc(TCpu6502* Cpu, uint8_t Value)
+{
+    int32_t  Borrow = (Cpu->P & CPU6502_C) ? 0 : 1;
+    uint32_t Diff   = Cpu->A - Value - Borrow;
+    // NMOS: all flags from the binary result, also in decimal mode
+    cpuFlag(Cpu, CPU6502_V, ((Cpu->A ^ Value) & (Cpu->A ^ Diff) & 0x80) != 0);
+    cpuFlag(Cpu, CPU6502_C, Diff < 0x100);
+    cpuNZ(Cpu, Diff);
+    if (Cpu->P & CPU6502_D)
+    {
+        int32_t Lo = (Cpu->A & 0x0f) - (Value & 0x0f) - Borrow;
+        int32_t Hi = (Cpu->A & 0xf0) - (Value & 0xf0);
+        if (Lo < 0)
+        {
+            Lo -= 0x06;
+            Hi -= 0x10;
+        }
+        if (Hi < 0)
+            Hi -= 0x60;
+        Diff = (Lo & 0x0f) | (Hi & 0xf0);
+    }
+    Cpu->A = Diff;
+}
+
+static void cpuCompare(TCpu6502* Cpu, uint8_t Register, uint8_t Value)
+{
+    cpuFlag(Cpu, CPU6502_C, Register >= Value);
+    cpuNZ(Cpu, Register - Value);
+}
+
+/** Shift/rotate/increment/decrement */
+static uint8_t cpuModify(TCpu6502* Cpu, uint8_t Op, uint8_t Value)
+{
+    uint8_t Carry = Cpu->P & CPU6502_C;
+    switch (Op)
+    {
+        case OP_ASL: cpuFlag(Cpu, CPU6502_C, Value & 0x80); Value <<= 1; break;
+        case OP_LSR: cpuFlag(Cpu, CPU6502_C, Value & 0x01); Value >>= 1; break;
+        case OP_ROL: cpuFlag(Cpu, CPU6502_C, Value & 0x80); Value = (Value << 1) | Carry; break;
+        case OP_ROR: cpuFlag(Cpu, CPU6502_C, Value & 0x01); Value = (Value >> 1) | (Carry << 7); break;
+        case OP_INC: Value++; break;
+        case OP_DEC: Value--; break;
+    }
+    return cpuNZ(Cpu, Value);
+}
+
+static void cpuBranch(TCpu6502* Cpu, bool Taken)
+{
+    int8_t Offset = cpuFetch(Cpu);
+    if (!Taken)
+        return;
+    uint16_t Target = Cpu->PC + Offset;
+    cpuRead(Cpu, Cpu->PC); // dummy read while adding the offset
+    if ((Target ^ Cpu->PC) & 0xff00)
+        cpuRead(Cpu, (Cpu->PC & 0xff00) | (Target & 0xff)); // dummy read while fixing the high byte
+    Cpu->PC = Target;
+}
+
+void cpu6502Reset(TCpu6502* Cpu)
+{
+    Cpu->A = Cpu->X = Cpu->Y = 0;
+    Cpu->S = 0xff;
+    Cpu->P = CPU6502_U | CPU6502_I;
+    Cpu->Halted = false;
+}
+
+uint32_t cpu6502Step(TCpu6502* Cpu)
+{
+    uint64_t Start = Cpu->Cycles;
+    uint16_t Address;
+    uint8_t  Value;
+
+    if (Cpu->Halted)
+        return 0;
+
+    uint8_t Opcode = cpuFetch(Cpu);
+    TOpcode Decoded = Opcodes[Opcode];
+
+    switch (Decoded.Op)
+    {
+        // reading instructions
+        case OP_LDA: case OP_LDX: case OP_LDY: case OP_ADC: case OP_SBC: case OP_AND: case OP_ORA:
+        case OP_EOR: case OP_CMP: case OP_CPX: case OP_CPY: case OP_BIT:
+            Address = cpuAddress(Cpu, Decoded.Mode, ACCESS_READ);
+            Value   = cpuRead(Cpu, Address);
+            switch (Decoded.Op)
+            {
+                case OP_LDA: Cpu->A = cpuNZ(Cpu, Value); break;
+                case OP_LDX: Cpu->X = cpuNZ(Cpu, Value); break;
+                case OP_LDY: Cpu->Y = cpuNZ(Cpu, Value); break;
+                case OP_ADC: cpuAdc(Cpu, Value); break;
+                case OP_SBC: cpuSbc(Cpu, Value); break;
+                case OP_AND: Cpu->A = cpuNZ(Cpu, Cpu->A & Value); break;
+                case OP_ORA: Cpu->A = cpuNZ(Cpu, Cpu->A | Value); break;
+                case OP_EOR: Cpu->A = cpuNZ(Cpu, Cpu->A ^ Value); break;
+                case OP_CMP: cpuCompare(Cpu, Cpu->A, Value); break;
+                case OP_CPX: cpuCompare(Cpu, Cpu->X, Value); break;
+                case OP_CPY: cpuCompare(Cpu, Cpu->Y, Value); break;
+                case OP_BIT:
+                    cpuFlag(Cpu, CPU6502_Z, (Cpu->A & Value) == 0);
+                    Cpu->P = (Cpu->P & ~(CPU6502_N|CPU6502_V)) | (Value & (CPU6502_N|CPU6502_V));
+                    break;
+            }
+            break;
+
+        // writing instructions
+        case OP_STA: case OP_STX: case OP_STY:
+            Address = cpuAddress(Cpu, Decoded.Mode, ACCESS_WRITE);
+            cpuWrite(Cpu, Address, (Decoded.Op == OP_STA) ? Cpu->A : (Decoded.Op == OP_STX) ? Cpu->X : Cpu->Y);
+            break;
+
+        // read-modify-write instructions
+        case OP_ASL: case OP_LSR: case OP_ROL: case OP_ROR: case OP_INC: case OP_DEC:
+            if (Decoded.Mode == AM_ACC)
+            {
+                cpuRead(Cpu, Cpu->PC);
+                Cpu->A = cpuModify(Cpu, Decoded.Op, Cpu->A);
+                break;
+            }
+            Address = cpuAddress(Cpu, Decoded.Mode, ACCESS_RMW);
+            Value   = cpuRead(Cpu, Address);
+            cpuWrite(Cpu, Address, Value); // NMOS writes the unmodified value first
+            cpuWrite(Cpu, Address, cpuModify(Cpu, Decoded.Op, Value));
+            break;
+
+        case OP_BPL: cpuBranch(Cpu, !(Cpu->P & CPU6502_N)); break;
+        case OP_BMI: cpuBranch(Cpu,  (Cpu->P & CPU6502_N)); break;
+        case OP_BVC: cpuBranch(Cpu, !(Cpu->P & CPU6502_V)); break;
+        case OP_BVS: cpuBranch(Cpu,  (Cpu->P & CPU6502_V)); break;
+        case OP_BCC: cpuBranch(Cpu, !(Cpu->P & CPU6502_C)); break;
+        case OP_BCS: cpuBranch(Cpu,  (Cpu->P & CPU6502_C)); break;
+        case OP_BNE: cpuBranch(Cpu, !(Cpu->P & CPU6502_Z)); break;
+        case OP_BEQ: cpuBranch(Cpu,  (Cpu->P & CPU6502_Z)); break;
+
+        case OP_JMP:
+            Address  = cpuFetch(Cpu);
+            Address |= cpuFetch(Cpu) << 8;
+            if (Decoded.Mode == AM_IND)
+            {
+                // NMOS: the pointer's high byte is read from the same page
+                uint16_t Target = cpuRead(Cpu, Address);
+                Target |= cpuRead(Cpu, (Address & 0xff00) | ((Address+1) & 0xff)) << 8;
+                Address = Target;
+            }
+            Cpu->PC = Address;
+            break;
+
+        case OP_JSR:
+            Address = cpuFetch(Cpu);
+            cpuRead(Cpu, 0x100 | Cpu->S); // internal cycle
+            cpuPush(Cpu, Cpu->PC >> 8);
+            cpuPush(Cpu, Cpu->PC & 0xff);
+            Address |= cpuFetch(Cpu) << 8;
+            Cpu->PC = Address;
+            break;
+
+        case OP_RTS:
+            cpuRead(Cpu, Cpu->PC);
+            cpuRead(Cpu, 0x100 | Cpu->S);
+            Address  = cpuPull(Cpu);
+            Address |= cpuPull(Cpu) << 8;
+            Cpu->PC = Address;
+            cpuFetch(Cpu); // increments the return address
+            break;
+
+        case OP_RTI:
+            cpuRead(Cpu, Cpu->PC);
+            cpuRead(Cpu, 0x100 | Cpu->S);
+            Cpu->P   = (cpuPull(Cpu) & ~CPU6502_B) | CPU6502_U;
+            Address  = cpuPull(Cpu);
+            Address |= cpuPull(Cpu) << 8;
+            Cpu->PC = Address;
+            break;
+
+        case OP_BRK:
+            cpuFetch(Cpu); // padding byte
+            cpuPush(Cpu, Cpu->PC >> 8);
+            cpuPush(Cpu, Cpu->PC & 0xff);
+            cpuPush(Cpu, Cpu->P | CPU6502_B | CPU6502_U);
+            Cpu->P |= CPU6502_I;
+            Address  = cpuRead(Cpu, 0xfffe);
+            Address |= cpuRead(Cpu, 0xffff) << 8;
+            Cpu->PC = Address;
+            break;
+
+        case OP_PHA:
+        case OP_PHP:
+            cpuRead(Cpu, Cpu->PC);
+            cpuPush(Cpu, (Decoded.Op == OP_PHA) ? Cpu->A : (Cpu->P | CPU6502_B | CPU6502_U));
+            break;
+
+        case OP_PLA:
+        case OP_PLP:
+            cpuRead(Cpu, Cpu->PC);
+            cpuRead(Cpu, 0x100 | Cpu->S);
+            Value = cpuPull(Cpu);
+            if (Decoded.Op == OP_PLA)
+                Cpu->A = cpuNZ(Cpu, Value);
+            else
+                Cpu->P = (Value & ~CPU6502_B) | CPU6502_U;
+            break;
+
+        // implied, two cycles
+        case OP_CLC: case OP_SEC: case OP_CLI: case OP_SEI: case OP_CLV: case OP_CLD: case OP_SED:
+        case OP_TAX: case OP_TXA: case OP_TAY: case OP_TYA: case OP_TSX: case OP_TXS:
+        case OP_DEX: case OP_DEY: case OP_INX: case OP_INY: case OP_NOP:
+            cpuRead(Cpu, Cpu->PC);
+            switch (Decoded.Op)
+            {
+                case OP_CLC: Cpu->P &= ~CPU6502_C; break;
+                case OP_SEC: Cpu->P |=  CPU6502_C; break;
+                case OP_CLI: Cpu->P &= ~CPU6502_I; break;
+                case OP_SEI: Cpu->P |=  CPU6502_I; break;
+                case OP_CLV: Cpu->P &= ~CPU6502_V; break;
+                case OP_CLD: Cpu->P &= ~CPU6502_D; break;
+                case OP_SED: Cpu->P |=  CPU6502_D; break;
+                case OP_TAX: Cpu->X = cpuNZ(Cpu, Cpu->A); break;
+                case OP_TXA: Cpu->A = cpuNZ(Cpu, Cpu->X); break;
+                case OP_TAY: Cpu->Y = cpuNZ(Cpu, Cpu->A); break;
+                case OP_TYA: Cpu->A = cpuNZ(Cpu, Cpu->Y); break;
+                case OP_TSX: Cpu->X = cpuNZ(Cpu, Cpu->S); break;
+                case OP_TXS: Cpu->S = Cpu->X; break;
+                case OP_DEX: Cpu->X = cpuNZ(Cpu, Cpu->X-1); break;
+                case OP_DEY: Cpu->Y = cpuNZ(Cpu, Cpu->Y-1); break;
+                case OP_INX: Cpu->X = cpuNZ(Cpu, Cpu->X+1); break;
+                case OP_INY: Cpu->Y = cpuNZ(Cpu, Cpu->Y+1); break;
+            }
+            break;
+
+        default:
+            // unsupported opcode: stop at it
+            Cpu->PC--;
+            Cpu->Halted = true;
+            return 0;
+    }
+
+    return Cpu->Cycles - Start;
+}
@@ -0,0 +1,66 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2024 Thorsten Brehm
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/* cpu6502.h: Minimal NMOS 6502 core for the host harness.
+
+   Every 6502 clock cycle is a bus cycle, so the core calls the bus functions
+   exactly once per cycle, including the dummy reads and writes of the real CPU
+   (indexed addressing, read-modify-write, stack operations). The number of bus
+   calls therefore is the number of 6502 cycles. Only the documented opcodes
+   are supported, interrupts are not (the harness runs with IRQs masked).
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Status register flags */
+#define CPU6502_C 0x01
+#define CPU6502_Z 0x02
+#define CPU6502_I 0x04
+#define CPU6502_D 0x08
+#define CPU6502_B 0x10
+#define CPU6502_U 0x20
+#define CPU6502_V 0x40
+#define CPU6502_N 0x80
+
+typedef struct
+{
+    uint16_t PC;
+    uint8_t  A, X, Y, S, P;
+    uint64_t Cycles;     /**< number of 6502 (bus) cycles */
+    bool     Halted;     /**< an unsupported opcode was fetched (PC points to it) */
+
+    /** Bus access functions, called once per 6502 cycle */
+    uint8_t (*Read) (uint16_t Address);
+    void    (*Write)(uint16_t Address, uint8_t Data);
+} TCpu6502;
+
+/** Register state after reset: IRQs masked, stack at $01FF. PC is set by the caller. */
+extern void cpu6502Reset(TCpu6502* Cpu);
+
+/** Execute a single instruction. Returns the number of cycles (0 when halted). */
+extern uint32_t cpu6502Step(TCpu6502* Cpu);
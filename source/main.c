@@ -41,27 +41,12 @@ SOFTWARE.
 #endif
 
 #ifdef FUNCTION_PROFILER
-	uint32_t ProfilerMaxTime;
+	uint32_t CORE1_DATA(ProfilerMaxTime);
+	uint32_t CORE1_DATA(ProfilerHistogram)[PROFILER_PATHS][PROFILER_BUCKETS];
+	uint8_t  CORE1_DATA(ProfilerLog2)[256];
 #endif
 
-#ifdef PLATFORM_A2VGA
-    /* number of bus cycles since last vertical blanking */
-    volatile uint32_t VblBusCycleCounter;
-    /* number of bus cycles in between screen blanking */
-    volatile uint32_t VblCycleCount;
-#endif
-
-static __always_inline void sys_reset(void)
-{
-  // Reset when the Apple II resets
-  mouseControllerReset();
-  ROMOffset = 0;
-
-  // stop logging on 6502 HW reset
-  LOGGER_STOP();
-}
-
-static void __noinline __time_critical_func(core1_loop)()
+static void __noinline CORE1_CODE(core1_loop)()
 {
     uint32_t value;
     uint32_t address;
@@ -73,6 +58,9 @@ static void __noinline __time_critical_func(core1_loop)()
     // enable systick timer, but keep timer exception disabled
     PROFILER_INIT(ProfilerMaxTime);
 
+    // core1 specific setup of the bus interface
+    usb_core1_init();
+
     for(;;)
     {
         // wait for next PIO event
@@ -81,41 +69,13 @@ static void __noinline __time_critical_func(core1_loop)()
         // start time measurement (count-down timer)
         PROFILER_START();
 
-        if(A2_IS_SELECT())
-        {
-            if(A2_IS_ACCESS_READ(address))
-              usb_busread(address);
-            else
-              usb_buswrite(address, value);
-        }
-#ifdef PLATFORM_A2VGA
-        else
-        {
-            if (A2_IS_RESET(value))
-            {
-            	sys_reset();
-  #ifdef FUNCTION_PROFILER
-                continue; // do not consider the "reset" call when profiling
-  #endif
-            }
-        }
-
-        // keep track of bus cycles vs vertical blanking
-        {
-            // get current number of bus cycles since last VBL event
-            uint32_t CycleCount = VblBusCycleCounter;
-            // reset counter on VBL event, otherwise keep counting
-            if (CycleCount >= VblCycleCount)
-                VblBusCycleCounter = 1;
-            else
-                VblBusCycleCounter = CycleCount+1;
-        }
-#endif
+        // process the bus cycle
+        uint32_t Path = usb_buscycle(value, address);
 
         LOGGER_LOG(value, address);
 
-        // start time measurement (count-down timer)
-        PROFILER_STOP(ProfilerMaxTime);
+        // stop time measurement
+        PROFILER_STOP(ProfilerMaxTime, Path);
     }
 }
 
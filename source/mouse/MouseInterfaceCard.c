@@ -125,12 +125,18 @@
 #ifdef FUNCTION_MOUSE
 
 #include <string.h>
+#include <stdlib.h>
 #ifdef PICO_BUILD
   #include <pico/stdlib.h>
   #include <pico/multicore.h>
   #include <hardware/sync.h>
-  #include "a2platform.h"
 #endif
+#include "a2platform.h"
+#include "dma/dmacopy.h"
+#include "util/profiler.h"
+#include "MouseInterfaceCard.h"
+#include "util/spscqueue.h"
+#include "util/doorbell.h"
 
 // include the ROM image here
 #include "MouseInterfaceROM.h"
@@ -142,12 +148,10 @@
   #define DEBUG_PRINT(...)
 #endif
 
-#ifdef PICO_BUILD
-    /** macro to set IRQ pin */
-    #define IRQ_ASSERT()    A2_SET_IRQ(1)
-    /** macro to clear IRQ pin */
-    #define IRQ_DEASSERT()  A2_SET_IRQ(0)
-#endif
+/** macro to set IRQ pin */
+#define IRQ_ASSERT()    A2_SET_IRQ(1)
+/** macro to clear IRQ pin */
+#define IRQ_DEASSERT()  A2_SET_IRQ(0)
 
 // inline the PIA emulation module for better performance
 #include "PIA6520.c"
@@ -157,6 +161,29 @@
 #define PIA_PORTB_RDREADY   0x40
 #define PIA_PORTB_WRACK     0x80
 
+/* Core1 serves the WRREQUEST/WRACK and RDACK/RDREADY handshakes as soon as
+ * the 6502 writes to PIA port B. Command bytes are queued for core0, which only
+ * runs the command logic, so the 6502 does not spin until core0 polls port B. */
+
+/** Port B at the previous port B write (core1) */
+uint8_t CORE1_DATA(Core1LastPortB);
+
+/** Reply bytes for the 6502, served by core1 */
+typedef struct
+{
+    uint8_t Buffer[8]; /**< copy of the read buffer */
+    uint8_t Pos;       /**< remaining bytes */
+} TMouseReply;
+
+/** Reply for the 6502, handed over through MouseEvents rather than a lock. Core0 writes it while the
+ *  command byte it just processed is still queued (before spscQueuePop, whose barrier publishes it).
+ *  Core1 only uses it while MouseEvents is empty, or while RDREADY is set: RDREADY is only set with
+ *  an empty queue, and core1 clears it whenever it queues a command byte. A 6502 reset clears it anyway. */
+TMouseReply CORE1_DATA(Core1Reply);
+
+/** Events from core1 to core0: the command bytes (already acknowledged by core1). */
+TSpscQueue CORE1_DATA(MouseEvents);
+
 /* Mouse Commands */
 #define COMMAND_SETMOUSE    0x00
 #define COMMAND_READMOUSE   0x10
@@ -195,13 +222,130 @@
 #define VBL_BUSCYCLES_60HZ     ((40+25)*(192+70))  /* Apple II NTSC: 40 clocks per line with 25 clocks for horizontal blanking x 192 lines + 70 vertical blanking lines */
 #define VBL_BUSCYCLES_50HZ     ((40+25)*(192+120)) /* Apple II PAL : 40 clocks per line with 25 clocks for horizontal blanking x 192 lines + 120 vertical blanking lines */
 
-/* VBL default frequency depends on region/firmware (PAL vs NTSC) */
+/* VBL default frequency depends on region/firmware (PAL vs NTSC), or is detected from the bus clock */
 #ifdef FUNCTION_PAL
     #define VBL_BUSCYCLES_DEFAULT  VBL_BUSCYCLES_50HZ  // for PAL
 #else
-    #define VBL_BUSCYCLES_DEFAULT  VBL_BUSCYCLES_60HZ  // for NTSC
+    #define VBL_BUSCYCLES_DEFAULT  VBL_BUSCYCLES_60HZ  // for NTSC (until detected otherwise)
+    #if (!defined(FUNCTION_NTSC))&&(defined(A2_VBL_COUNTER))
+        #define FEATURE_REGION_DETECT 1
+    #endif
+#endif
+
+/* VBL events are timed by the PICO instead, when bus cycles aren't video time (non-Apple II bus clock) */
+#ifdef A2_VBL_TIMER
+    #define FEATURE_VBL_TIMER 1
+#endif
+
+#if (defined(FEATURE_REGION_DETECT))||(defined(FEATURE_VBL_TIMER))
+/* Average Apple II bus clocks: 14M/14, with one stretched cycle (2 extra 14M clocks) per 65 cycles.
+ * The crystals differ by 0.47%, which is easily measured against the PICO's timer. */
+#define BUSCLOCK_NTSC          1020484 /* 14.31818MHz*65/912 */
+#define BUSCLOCK_PAL           1015657 /* 14.25045MHz*65/912 */
+#define BUSCLOCK_TOLERANCE     10000   /* anything else isn't an Apple II's bus clock (or the measurement was disturbed) */
+#define BUSCLOCK_FRAMES        8       /* screen refreshes to measure (about 150ms) */
+#define BUSCLOCK_FOREIGN       2       /* measurements confirming an unusual bus clock */
+
+/** Bus clock measurement, which tells PAL from NTSC machines (core0) */
+static struct
+{
+    bool     Done;
+    uint32_t LastEvents;
+    uint32_t Frames;      /**< number of measured screen refreshes */
+    uint32_t Cycles;      /**< bus cycles of these screen refreshes */
+    uint32_t Time;        /**< time of these screen refreshes (A2_TIMESTAMP units) */
+    uint32_t Foreign;     /**< number of consecutive measurements of an unusual bus clock */
+} BusClock;
+#endif
+
+#ifdef FEATURE_VBL_TIMER
+/** Source of the VBL events: counted bus cycles, or time (nominal bus clock, for an unusual bus clock) */
+static struct
+{
+    bool              Timed;   /**< bus cycles aren't video time: use the timer */
+    volatile uint32_t Clock;   /**< nominal bus clock for the timer (0: count bus cycles) */
+    uint32_t          Applied; /**< Clock, as configured by core0 */
+} VblSource;
+#endif
+
+/** Number of bus cycles per screen refresh after a reset (detected region, or the firmware's default) */
+static volatile uint32_t VblDefaultPeriod = VBL_BUSCYCLES_DEFAULT;
+
+#ifdef A2_VBL_COUNTER
+/** Set by core1 on a 6502 reset: core0 restores the default VBL period */
+static volatile bool VblResetPending;
+#endif
+
+/* Length of the vertical blanking itself */
+#define VBL_BLANKING_60HZ      ((40+25)*70)
+#define VBL_BLANKING_50HZ      ((40+25)*120)
+
+/* Phase lock parameters (bus cycles) */
+#define VBLSYNC_LATENCY        3  /* a polling loop sees the VBL bit change a few cycles late */
+#define VBLSYNC_TOLERANCE      16 /* when telling VBL start from end */
+#define VBLSYNC_DEADBAND       4  /* phase errors which are ignored (polling loops take about 7 cycles) */
+#define VBLSYNC_MIN_FRAMES     4  /* minimum number of frames for estimating the period from the phase drift */
+#define VBLSYNC_MAX_TRIM       (64 << A2_VBL_FRACTION_BITS) /* maximum period correction */
+
+/** $C019 polling loops, snooped by core1 */
+TVblSnoop CORE1_DATA(VblSnoop);
+
+/** State of the VBL phase lock (core0) */
+static struct
+{
+    uint32_t Period;         /**< nominal number of bus cycles per screen refresh */
+    int32_t  Trim;           /**< period correction (fixed point, A2_VBL_FRACTION_BITS) */
+    bool     Locked;         /**< VBL start vs end was identified at least once */
+    bool     HaveEdge;       /**< LastEdge is valid */
+    bool     Corrected;      /**< CorrectionTime is valid */
+    uint32_t LastEdge;       /**< time of the previous VBL transition */
+    bool     HaveRef;        /**< RefEdge/RefError are valid */
+    uint32_t CorrectionTime; /**< time of the last phase correction */
+    uint32_t RefEdge;        /**< time of the last transition used for the period estimation */
+    int32_t  RefError;       /**< remaining phase error at RefEdge (after any correction) */
+} VblLock;
+
+/* USB motion is accumulated, and only moves the position (and is clamped) when the
+ * 6502 takes a snapshot: with any command (READMOUSE) or with a VBL interrupt.
+ * Movement interrupts still apply the motion of each report. */
+
+/* Fixed point format of the motion accumulator */
+#define MOTION_FRACTION_BITS   8
+#define MOTION_LIMIT           (0x10000 << MOTION_FRACTION_BITS) /* beyond any clamp window */
+
+/* Pointer acceleration scales USB mouse motion by a gain, which depends on the speed
+ * (counts per report) and on the width of the X clamp window: small windows get sub-pixel
+ * precision for slow movements, fast flicks cross any window quickly. It is off (1:1, as
+ * existing 6502 software expects) unless enabled by the build or mouseControllerAccel. */
+#ifdef FUNCTION_POINTER_ACCEL
+  #define ACCEL_DEFAULT        true
+#else
+  #define ACCEL_DEFAULT        false
 #endif
 
+/* Speed buckets: larger of |X| and |Y| per report, 2 counts per bucket */
+#define ACCEL_SPEEDS           16
+#define ACCEL_SPEED_SHIFT      1
+/* Width of the X clamp window the curve is defined for (the default window) */
+#define ACCEL_WINDOW_BITS      10
+/* Maximum gain: keeps 16bit deltas times the gain within 32bit */
+#define ACCEL_GAIN_MAX         0xFFFF
+
+/** Gain per speed bucket for the default window (fixed point, MOTION_FRACTION_BITS):
+ *  1:1 for slow movements, rising to 4x for fast ones. */
+static const uint16_t AccelCurve[ACCEL_SPEEDS] =
+{
+    256, 256, 288, 320, 368, 416, 480, 544, 608, 672, 736, 800, 864, 928, 992, 1024
+};
+
+/** Acceleration state (core0) */
+static struct
+{
+    bool     Enabled;
+    uint32_t Window;               /**< X clamp window width the gains were scaled for (0: none) */
+    uint32_t Gain[ACCEL_SPEEDS];   /**< AccelCurve, scaled to the window */
+} Accel = { .Enabled = ACCEL_DEFAULT };
+
 typedef struct
 {
     uint8_t Command;        /**< Current command byte. */
@@ -209,14 +353,20 @@ typedef struct
     uint8_t WriteBuffer[8]; /**< Write buffer: data from 6502 sent to 6805 mouse slave controller. */
     uint8_t ReadPos;
     uint8_t WritePos;
-    uint8_t LastPortB;
 
     bool    Vbl50HzMode;
-    uint32_t LastBusCycleCounter;
+    bool    VblTimeSet;      /**< TIMEMOUSE was used (overrides the region detection) */
+    uint32_t LastVblEvents;
 
     uint8_t OperatingMode;
     uint8_t IntState;
 
+    struct
+    {
+        int32_t X;
+        int32_t Y;
+    } Motion;               /**< motion since the last snapshot (fixed point, MOTION_FRACTION_BITS) */
+
     struct
     {
         uint16_t X;
@@ -245,6 +395,39 @@ typedef struct
 
 TA2Mouse Mouse;
 
+static void mouseMotionApply(void);
+
+TLatencyStats MouseLatency;
+TLatencyStats MouseReportInterval;
+
+/** Timing of the USB mouse reports (core0) */
+static struct
+{
+    bool     Valid;       /**< LastReport is valid */
+    uint32_t LastReport;  /**< time of the most recent report */
+    bool     Pending;     /**< there is motion which the 6502 has not read yet */
+    uint32_t Oldest;      /**< time of the oldest report with unread motion */
+} ReportTime;
+
+#ifndef FW_VERSION
+  #define FW_VERSION "dev"
+#endif
+
+_Static_assert(sizeof(TMouseDiagnostics) <= 0xff, "Diagnostics window exceeds its size byte.");
+
+/** Counters for the diagnostics window (core0, VblPeriod also written by core1 on reset) */
+static struct
+{
+    uint8_t           UsbDevices;
+    uint32_t          Reports;
+    volatile uint32_t VblPeriod;
+    uint32_t          BusClock;
+    uint32_t          IrqVbl;
+    uint32_t          IrqMovement;
+    uint32_t          IrqButton;
+    TMouseDiagnostics Snapshot; /**< window contents, as read by RDMEMMOUSE */
+} Diag;
+
 static void clampXY()
 {
     if (Mouse.Current.X < Mouse.Clamp.MinX)
@@ -285,6 +468,13 @@ static void mouseCommandRead()
 
     Mouse.IntState = IntState & ~STATUS_MOVED;
 
+    // the motion of all reports so far is read now
+    if (ReportTime.Pending)
+    {
+        latencyAdd(&MouseLatency, A2_TIMESTAMP() - ReportTime.Oldest);
+        ReportTime.Pending = false;
+    }
+
     memcpy(&Mouse.Last, &Mouse.Current, sizeof(Mouse.Current));
 
     Mouse.ReadPos = 5; // 5 bytes to be read
@@ -327,28 +517,67 @@ static void mouseCommandInit()
     Mouse.Clamp.MaxX = Mouse.Clamp.MaxY = 1023;
     Mouse.Clamp.MinX = Mouse.Clamp.MinY = 0;
 
-#ifdef PLATFORM_A2VGA
-    Mouse.LastBusCycleCounter = 0;
-    /* It's not cheating when it works: we need to reset the VBL cycle counter,
-     * which is maintained by the other core. To avoid a synchronization
-     * lock, which would interfere with the other core's strict execution
-     * requirements, we simple reset the VBL counter several times.
-     * We know the other core occasionally does a very quick read-modify-write
-     * on this variable, so if we write it multiple times in quick
-     * succession, we will win at least once. The VBL timing isn't exact to
-     * a nanosecond anyway, so this is absolutey good enough. */
-    for (uint8_t i=0;i<4;i++)
-    {
-        // just write the volatile variable multiple times
-        VblBusCycleCounter = 1;
-        asm volatile("nop");
-    }
+#ifdef A2_VBL_COUNTER
+    // the screen refresh period starts over (core1 isn't involved in VBL counting)
+    A2_VBL_RESTART();
+    Mouse.LastVblEvents = A2_VBL_EVENTS();
 #endif
 
     mouseCommandHome();
     IRQ_DEASSERT();
 }
 
+/** Copy the current counters to the diagnostics window. */
+static void mouseDiagSnapshot(void)
+{
+    static const char Version[sizeof(Diag.Snapshot.Version)] = FW_VERSION;
+    TMouseDiagnostics* d = &Diag.Snapshot;
+
+    memset(d, 0, sizeof(*d));
+    d->Layout      = DIAG_LAYOUT_VERSION;
+    d->Size        = sizeof(*d);
+    d->UsbDevices  = Diag.UsbDevices;
+    memcpy(d->Version, Version, sizeof(d->Version));
+    d->VblPeriod   = Diag.VblPeriod;
+    d->BusClock    = Diag.BusClock;
+    d->IrqVbl      = Diag.IrqVbl;
+    d->IrqMovement = Diag.IrqMovement;
+    d->IrqButton   = Diag.IrqButton;
+    d->Dropped     = MouseEvents.Dropped;
+    if (Mouse.Vbl50HzMode)
+        d->Flags |= DIAG_FLAG_VBL_50HZ;
+#ifdef FUNCTION_PROFILER
+    d->Flags |= DIAG_FLAG_PROFILER;
+#endif
+#ifdef A2_VBL_COUNTER
+    d->VblEvents = A2_VBL_EVENTS();
+#endif
+    if (VblLock.Locked)
+        d->Flags |= DIAG_FLAG_VBL_LOCKED;
+    if (Accel.Enabled)
+        d->Flags |= DIAG_FLAG_ACCEL;
+#ifdef A2_PHASE0_NS
+    d->Phase0      = A2_PHASE0_NS();
+    d->ReadAdvance = A2_READ_ADVANCE_NS();
+    if (A2_PHASE0_SHORT())
+        d->Flags |= DIAG_FLAG_PHASE0_SHORT;
+#endif
+    d->Flags |= DIAG_FLAG_LATENCY;
+    d->Reports = Diag.Reports;
+    // mice only report while moving: the median interval is the polling rate
+    uint32_t Interval = latencyPercentile(&MouseReportInterval, 500);
+    if (Interval)
+        d->ReportRate = (A2_TIMESTAMP_HZ + Interval/2) / Interval;
+    d->LatencyCount = MouseLatency.Count;
+    if (MouseLatency.Count)
+    {
+        d->LatencyMin = MouseLatency.Min;
+        d->LatencyAvg = latencyAverage(&MouseLatency);
+        d->LatencyP99 = latencyPercentile(&MouseLatency, 990);
+        d->LatencyMax = MouseLatency.Max;
+    }
+}
+
 /* See Apple II Technical Notes, Mouse #7: Mouse Clamping.
  * Apple documented a workaround how to read the clamping values from
  * the Mouse Card. They used a previously undocumnted internal command
@@ -387,6 +616,22 @@ static void mouseCommandReadMem()
             Mouse.ReadBuffer[0] = Mouse.Clamp.MaxY; // MaxYL
             break;
         default:
+            if ((address >= DIAG_RDMEM_BASE)&&(address < DIAG_RDMEM_BASE+sizeof(TMouseDiagnostics)))
+            {
+                // diagnostics (not an original 6805 address): the first byte takes the snapshot
+                if (address == DIAG_RDMEM_BASE)
+                    mouseDiagSnapshot();
+                Mouse.ReadBuffer[0] = ((uint8_t*)&Diag.Snapshot)[address-DIAG_RDMEM_BASE];
+                break;
+            }
+#ifdef FUNCTION_PROFILER
+            if ((address >= PROFILER_RDMEM_BASE)&&(address < PROFILER_RDMEM_BASE+PROFILER_RDMEM_SIZE))
+            {
+                // profiler histograms (not an original 6805 address)
+                Mouse.ReadBuffer[0] = ((uint8_t*)ProfilerHistogram)[address-PROFILER_RDMEM_BASE];
+                break;
+            }
+#endif
             Mouse.ReadBuffer[0] = 0x00; // illegal/undocumented memory address
             break;
     }
@@ -421,15 +666,39 @@ static void mouseCommandClamp()
     clampXY();
 }
 
+/** Set the number of bus cycles in between VBL events. */
+static void mouseVblPeriod(uint32_t Period)
+{
+    Diag.VblPeriod = Period;
+    // the lock needs to be found again
+    VblLock.Period   = Period;
+    VblLock.Trim     = 0;
+    VblLock.Locked   = false;
+    VblLock.HaveEdge = false;
+    VblLock.Corrected = false;
+    VblLock.HaveRef  = false;
+#ifdef A2_VBL_COUNTER
+    A2_VBL_PERIOD(Period << A2_VBL_FRACTION_BITS);
+#endif
+#ifdef FEATURE_VBL_TIMER
+    // the timer runs at the video rate for the selected period (switched by core0)
+    if (VblSource.Timed)
+        VblSource.Clock = (Period == VBL_BUSCYCLES_50HZ) ? BUSCLOCK_PAL : BUSCLOCK_NTSC;
+#endif
+}
+
 static void mouseCommandTime()
 {
     Mouse.Vbl50HzMode = (Mouse.Command & 0x1); // bit 0: 1=50Hz, 0=60Hz
+    Mouse.VblTimeSet  = true;
     // configure number of bus cycles in between VBL events
-    VblCycleCount = (Mouse.Vbl50HzMode) ? VBL_BUSCYCLES_50HZ : VBL_BUSCYCLES_60HZ;
+    mouseVblPeriod((Mouse.Vbl50HzMode) ? VBL_BUSCYCLES_50HZ : VBL_BUSCYCLES_60HZ);
 }
 
 static void mouseCommand(void)
 {
+    // any command sees (or overwrites) the position with all motion so far
+    mouseMotionApply();
     switch(Mouse.Command & 0xF0)
     {
         case COMMAND_SETMOUSE:    mouseCommandSet();    break;
@@ -450,15 +719,15 @@ static void mouseCommand(void)
     }
 }
 
-static void mouseControllerAcceptData(void)
+static void mouseControllerAcceptData(uint8_t Data)
 {
     // fallinge-edge detected
     if (Mouse.WritePos)  // we were waiting for more parameter data
-        Mouse.WriteBuffer[--Mouse.WritePos] = PIA6520_PORTA();
+        Mouse.WriteBuffer[--Mouse.WritePos] = Data;
     else
     {
         // no parameters pending: new command starting...
-        Mouse.Command = PIA6520_PORTA();
+        Mouse.Command = Data;
 
         // now let's see how many parameters we need for this command
         switch(Mouse.Command & 0xF0)
@@ -491,106 +760,88 @@ static void mouseControllerAcceptData(void)
     }
 }
 
-/** Process write data: returns true when a new command is available */
-static void mouseControllerWrite(uint8_t portB)
+/** Present the next reply byte and set RDREADY, unless a write transfer is in progress
+ *  or core0 has not yet processed all command bytes. Requires the PIA spin lock. */
+static __always_inline void mouseControllerReadReady(uint8_t PortB)
 {
-    // write
-    if (portB & PIA_PORTB_WRREQUEST)
+    // as above: we always indicate RDREADY, to avoid the ROM getting stuck on unexpected reads
+    if (((PortB & (PIA_PORTB_WRACK|PIA_PORTB_WRREQUEST|PIA_PORTB_RDACK)) == 0)&&
+        ((Pia.IB & PIA_PORTB_RDREADY) == 0)&&
+        (spscQueueEmpty(&MouseEvents)))
     {
-        if (Mouse.ReadPos)
-        {
-            DEBUG_PRINT("MOUSE: %u bytes of data were not retrieved.\n", Mouse.ReadPos);
-        }
-
-        // clears pending output data
-        Mouse.ReadPos = 0;
-
-        mouseControllerAcceptData();
-
-        // acknowledge data from 6502
-        PIA6520_inputB((Pia.IB & ~PIA_PORTB_RDREADY) | PIA_PORTB_WRACK);
-    }
-    else
-    {
-        // clear acknowledge
-        if (Pia.IB & PIA_PORTB_WRACK)
-            PIA6520_inputB(Pia.IB & ~PIA_PORTB_WRACK);
+        // set port A to data
+        Pia.IA = (Core1Reply.Pos>0) ? Core1Reply.Buffer[Core1Reply.Pos-1] : 0x00;
+        PIA6520_IMAGE_A();
+        // read data is ready
+        Pia.IB |= PIA_PORTB_RDREADY;
+        PIA6520_IMAGE_B();
     }
 }
 
-/** Process read data: returns the read buffer content to the 6502 */
-static void mouseControllerRead(uint8_t portB)
+void CORE1_CODE(mouseControllerPortB)(void)
 {
-    // read acknowledge?
-    if (portB & PIA_PORTB_RDACK)
+    uint8_t PortB   = PIA6520_PORTB();
+    uint8_t Changed = PortB ^ Core1LastPortB;
+    Core1LastPortB  = PortB;
+
+    if (Changed & PIA_PORTB_WRREQUEST)
     {
-        if (Pia.IB & PIA_PORTB_RDREADY)
+        if (PortB & PIA_PORTB_WRREQUEST)
         {
-            //DEBUG_PRINT("mouseControllerRead: read complete, ReadPos=%u\n",Mouse.ReadPos);
-            if (Mouse.ReadPos > 0)
-                Mouse.ReadPos--;
-            else
-            {
-                DEBUG_PRINT("MOUSE: Unexpected read. Command=%02x\n", Mouse.Command);
-            }
-            // clear read-ready flag
-            PIA6520_inputB(Pia.IB & ~PIA_PORTB_RDREADY);
+            // pass data to core0 (the 6502 never sends more than a few bytes ahead)
+            spscQueuePush(&MouseEvents, PIA6520_PORTA());
+            DOORBELL_RING(DOORBELL_PIA);
+            // acknowledge data from 6502
+            Pia.IB = (Pia.IB & ~PIA_PORTB_RDREADY) | PIA_PORTB_WRACK;
+        }
+        else
+        {
+            // clear acknowledge
+            Pia.IB &= ~PIA_PORTB_WRACK;
         }
+        PIA6520_IMAGE_B();
     }
-    else
+
+    // independent of WRREQUEST: both may change with the same write
+    if (Changed & PIA_PORTB_RDACK)
     {
-        /* Normally we would only need to indicate RDREADY when we have data available after a command.
-           However, to avoid issues with the ROM getting stuck, we always indicated "RDREADY", unless
-           a write operation is currently pending. This avoids issues when the ROM firmware was making an
-           'unexpected read' (since there are no timeouts, "of course", so if it got stuck, then it'd be
-           stuck forever...).
-         */
-        //if (Mouse.ReadPos > 0)
-        if ((portB & (PIA_PORTB_WRACK|PIA_PORTB_WRREQUEST))==0)
+        if (PortB & PIA_PORTB_RDACK)
         {
-            if ((Pia.IB & PIA_PORTB_RDREADY) == 0)
+            // read acknowledge
+            if (Pia.IB & PIA_PORTB_RDREADY)
             {
-               //DEBUG_PRINT("mouseControllerRead: read, ReadPos=%u\n", Mouse.ReadPos);
-               // set port A to data
-               PIA6520_inputA((Mouse.ReadPos>0) ? Mouse.ReadBuffer[Mouse.ReadPos-1] : 0x00);
-               // read data is ready
-               PIA6520_inputB(Pia.IB | PIA_PORTB_RDREADY);
+                if (Core1Reply.Pos > 0)
+                    Core1Reply.Pos--;
+                // clear read-ready flag
+                Pia.IB &= ~PIA_PORTB_RDREADY;
+                PIA6520_IMAGE_B();
             }
         }
+        else
+        {
+            // next byte (WRACK may have changed above)
+            mouseControllerReadReady(PIA6520_PORTB());
+        }
     }
 }
 
-/** Mouse movement reports are processed here. */
-void mouseControllerMoveXY(int8_t X, int8_t Y)
+/** Move the current position, clamped to the window in the direction of the movement. */
+static void mouseMovePosition(int32_t X, int32_t Y)
 {
     uint16_t OldX = Mouse.Current.X;
     uint16_t OldY = Mouse.Current.Y;
+    int32_t  NewX = OldX + X;
+    int32_t  NewY = OldY + Y;
 
-    // update current position, avoid over- and underflows, clamp to range
+    // update current position
     if (X>0)
-    {
-        Mouse.Current.X += X;
-        if ((Mouse.Current.X < OldX)||(Mouse.Current.X>Mouse.Clamp.MaxX))
-            Mouse.Current.X = Mouse.Clamp.MaxX;
-    }
+        Mouse.Current.X = (NewX > Mouse.Clamp.MaxX) ? Mouse.Clamp.MaxX : NewX;
     else
-    {
-        Mouse.Current.X += X;
-        if ((Mouse.Current.X > OldX)||(Mouse.Current.X<Mouse.Clamp.MinX))
-            Mouse.Current.X = Mouse.Clamp.MinX;
-    }
+        Mouse.Current.X = (NewX < Mouse.Clamp.MinX) ? Mouse.Clamp.MinX : NewX;
     if (Y>0)
-    {
-        Mouse.Current.Y += Y;
-        if ((Mouse.Current.Y < OldY)||(Mouse.Current.Y>Mouse.Clamp.MaxY))
-            Mouse.Current.Y = Mouse.Clamp.MaxY;
-    }
+        Mouse.Current.Y = (NewY > Mouse.Clamp.MaxY) ? Mouse.Clamp.MaxY : NewY;
     else
-    {
-        Mouse.Current.Y += Y;
-        if ((Mouse.Current.Y > OldY)||(Mouse.Current.Y<Mouse.Clamp.MinY))
-            Mouse.Current.Y = Mouse.Clamp.MinY;
-    }
+        Mouse.Current.Y = (NewY < Mouse.Clamp.MinY) ? Mouse.Clamp.MinY : NewY;
 
     // was there any actual movement?
     if ((Mouse.Current.X != OldX)||
@@ -604,6 +855,83 @@ void mouseControllerMoveXY(int8_t X, int8_t Y)
     }
 }
 
+/** Snapshot: move the position by the whole units of the accumulated motion. */
+static void mouseMotionApply(void)
+{
+    int32_t X = Mouse.Motion.X >> MOTION_FRACTION_BITS;
+    int32_t Y = Mouse.Motion.Y >> MOTION_FRACTION_BITS;
+    if (X || Y)
+    {
+        Mouse.Motion.X -= X * (1 << MOTION_FRACTION_BITS);
+        Mouse.Motion.Y -= Y * (1 << MOTION_FRACTION_BITS);
+        mouseMovePosition(X, Y);
+    }
+}
+
+/** Add to the motion accumulator (saturating). 64bit: a 16bit delta times the gain is close to 2^31 already. */
+static inline int32_t mouseMotionAdd(int32_t Motion, int64_t Delta)
+{
+    int64_t Sum = Motion + Delta;
+    return (Sum > MOTION_LIMIT) ? MOTION_LIMIT : (Sum < -MOTION_LIMIT) ? -MOTION_LIMIT : (int32_t) Sum;
+}
+
+/** Scale the acceleration curve to the width of the X clamp window (both axes use the same gain). */
+static void mouseAccelScale(uint32_t Window)
+{
+    Accel.Window = Window;
+    for (uint32_t i=0;i<ACCEL_SPEEDS;i++)
+    {
+        uint32_t Gain = (Accel.Enabled) ? (AccelCurve[i] * Window) >> ACCEL_WINDOW_BITS : (1 << MOTION_FRACTION_BITS);
+        Accel.Gain[i] = (Gain > ACCEL_GAIN_MAX) ? ACCEL_GAIN_MAX : Gain;
+    }
+}
+
+void mouseControllerAccel(bool Enable)
+{
+    Accel.Enabled = Enable;
+    Accel.Window  = 0; // scaled with the next report
+}
+
+/** Gain for the speed of a report (fixed point, MOTION_FRACTION_BITS). */
+static inline int32_t mouseAccelGain(int16_t X, int16_t Y)
+{
+    uint32_t Window = (uint32_t) Mouse.Clamp.MaxX - Mouse.Clamp.MinX + 1;
+    if (Window != Accel.Window)
+        mouseAccelScale(Window);
+    uint32_t Speed = (uint32_t)((abs(X) > abs(Y)) ? abs(X) : abs(Y)) >> ACCEL_SPEED_SHIFT;
+    return Accel.Gain[(Speed < ACCEL_SPEEDS) ? Speed : ACCEL_SPEEDS-1];
+}
+
+void mouseControllerReportTime(uint32_t Time)
+{
+    if (ReportTime.Valid)
+        latencyAdd(&MouseReportInterval, Time - ReportTime.LastReport);
+    ReportTime.LastReport = Time;
+    ReportTime.Valid      = true;
+    Diag.Reports++;
+}
+
+void mouseControllerUsbDevices(uint8_t Count)
+{
+    Diag.UsbDevices = Count;
+}
+
+/** Mouse movement reports are processed here. */
+void mouseControllerMoveXY(int16_t X, int16_t Y)
+{
+    if ((ReportTime.Valid)&&(!ReportTime.Pending))
+    {
+        ReportTime.Oldest  = ReportTime.LastReport;
+        ReportTime.Pending = true;
+    }
+    int32_t Gain = mouseAccelGain(X, Y);
+    Mouse.Motion.X = mouseMotionAdd(Mouse.Motion.X, (int64_t) X * Gain);
+    Mouse.Motion.Y = mouseMotionAdd(Mouse.Motion.Y, (int64_t) Y * Gain);
+    // movement interrupts are raised right away, otherwise wait for the next snapshot
+    if ((Mouse.OperatingMode & MOUSE_MODE_MOVED_IRQ) == MOUSE_MODE_MOVED_IRQ)
+        mouseMotionApply();
+}
+
 /** Mouse button reports are processed here. */
 void mouseControllerUpdateButton(uint8_t ButtonNr, bool Pressed)
 {
@@ -619,39 +947,260 @@ void mouseControllerUpdateButton(uint8_t ButtonNr, bool Pressed)
     }
 }
 
-/** Simple VBL IRQ generation. This needs to be improved to be really synchronous to the 6502 VBL. */
+/** VBL IRQ generation, synchronous to the VBL bus cycle counter (phase locked to $C019 polling loops). */
 static void mouseControllerVblIrq(void)
 {
     // Vertical BLanking interrupt enabled?
     if ((Mouse.OperatingMode & MOUSE_MODE_VBL_IRQ) == MOUSE_MODE_VBL_IRQ)
     {
-        // trigger interrupt when VBL bus cycle count has wrapped to be
+        // trigger interrupt when the VBL bus cycle counter has wrapped to be
         // synchronous with system's vertical blanking.
-        uint32_t BusCycleCounter = VblBusCycleCounter; // copy volatile data
-        if (BusCycleCounter < Mouse.LastBusCycleCounter)
+        uint32_t VblEvents = A2_VBL_EVENTS(); // copy volatile data
+        if (VblEvents != Mouse.LastVblEvents)
         {
+            // snapshot of the motion, for the interrupt handler
+            mouseMotionApply();
             // counter has wrapped: trigger IRQ
             Mouse.IntState |= STATUS_IRQ_VBL;
         }
-        // remember current cycle counter
-        Mouse.LastBusCycleCounter = BusCycleCounter;
+        // remember current number of VBL events
+        Mouse.LastVblEvents = VblEvents;
     }
 }
 
+/** Wrap a phase difference to -Period/2..Period/2. */
+static int32_t mouseVblWrap(int32_t Cycles, int32_t Period)
+{
+    if (Cycles > Period/2)
+        Cycles -= Period;
+    else
+    if (Cycles < -Period/2)
+        Cycles += Period;
+    return Cycles;
+}
+
+/** Process a VBL transition seen by a $C019 polling loop. Times are in A2_TIMESTAMP units. Interval is the
+ *  time of the last screen refresh, which took Cycles bus cycles, so time stamps are converted to bus cycles
+ *  without knowing the clock. */
+static void mouseVblEdge(uint32_t Edge, uint32_t Now, uint32_t VblTime, uint32_t Interval, uint32_t Cycles)
+{
+    int32_t Period   = VblLock.Period + (VblLock.Trim >> A2_VBL_FRACTION_BITS);
+    int32_t Blanking = (VblLock.Period == VBL_BUSCYCLES_50HZ) ? VBL_BLANKING_50HZ : VBL_BLANKING_60HZ;
+    int32_t Expected = -1;
+
+    // position of the transition in the screen refresh, relative to our VBL event (bus cycles)
+    int32_t Phase = (((int64_t)(int32_t)(Edge - VblTime)) * Cycles) / Interval;
+    Phase %= Period;
+    if (Phase < 0)
+        Phase += Period;
+
+    // VBL end follows VBL start after the blanking, VBL start follows VBL end after the visible screen
+    if ((VblLock.HaveEdge)&&(Edge - VblLock.LastEdge < 4*Interval))
+    {
+        int32_t Distance = ((((int64_t)(Edge - VblLock.LastEdge)) * Cycles) / Interval) % Period;
+        if (abs(Distance - Blanking) <= VBLSYNC_TOLERANCE)
+            Expected = Blanking;
+        else
+        if (abs(Distance - (Period - Blanking)) <= VBLSYNC_TOLERANCE)
+            Expected = 0;
+    }
+    VblLock.LastEdge = Edge;
+    VblLock.HaveEdge = true;
+
+    if (Expected < 0)
+    {
+        // single transition: only usable once we know where the VBL roughly is
+        if (!VblLock.Locked)
+            return;
+        Expected = (abs(mouseVblWrap(Phase - Blanking, Period)) < abs(mouseVblWrap(Phase, Period))) ? Blanking : 0;
+    }
+    VblLock.Locked = true;
+
+    // ignore transitions which were measured before the last correction was in effect
+    // (the phase shift is applied to the screen refresh after the next one)
+    if ((VblLock.Corrected)&&((int32_t)(Edge - VblLock.CorrectionTime) < (int32_t)(3*Interval)))
+        return;
+
+    // positive: the real VBL is late compared to ours
+    int32_t Error = mouseVblWrap(Phase - VBLSYNC_LATENCY - Expected, Period);
+
+    // phase drift since the reference measurement: the period is off (by a fraction of a cycle per frame, usually)
+    uint32_t Frames = (Edge - VblLock.RefEdge) / Interval;
+    if ((!VblLock.HaveRef)||(Frames >= 64))
+    {
+        // (new) reference
+        VblLock.RefEdge  = Edge;
+        VblLock.RefError = Error;
+        VblLock.HaveRef  = true;
+    }
+    else
+    if (Frames >= VBLSYNC_MIN_FRAMES)
+    {
+        // integrate half of the measured period error
+        VblLock.Trim += ((Error - VblLock.RefError) << A2_VBL_FRACTION_BITS) / (2*(int32_t) Frames);
+        if (VblLock.Trim > VBLSYNC_MAX_TRIM)
+            VblLock.Trim = VBLSYNC_MAX_TRIM;
+        else
+        if (VblLock.Trim < -VBLSYNC_MAX_TRIM)
+            VblLock.Trim = -VBLSYNC_MAX_TRIM;
+        A2_VBL_PERIOD((VblLock.Period << A2_VBL_FRACTION_BITS) + VblLock.Trim);
+        VblLock.RefEdge  = Edge;
+        VblLock.RefError = Error;
+    }
+
+    if (abs(Error) <= VBLSYNC_DEADBAND)
+        return;
+
+    // shift the phase once
+    A2_VBL_ADJUST(Error);
+    VblLock.CorrectionTime = Now;
+    VblLock.Corrected      = true;
+    if (VblLock.RefEdge == Edge)
+        VblLock.RefError = 0;
+}
+
+/** Phase lock the VBL events to the VBL transitions seen by core1. */
+static void mouseControllerVblSync(void)
+{
+    while (!spscQueueEmpty(&VblSnoop.Edges))
+    {
+        uint16_t Stamp = spscQueuePeek(&VblSnoop.Edges);
+        spscQueuePop(&VblSnoop.Edges);
+
+        // the most recent VBL event and the time in between the last two
+        uint32_t IrqStatus = save_and_disable_interrupts();
+        uint32_t VblTime   = A2_VBL_TIME();
+        uint32_t Interval  = A2_VBL_INTERVAL();
+        uint32_t Cycles    = A2_VBL_CYCLES();
+        uint32_t Now       = A2_TIMESTAMP();
+        restore_interrupts(IrqStatus);
+
+        // counter isn't running long enough yet
+        if (!Interval)
+            continue;
+
+        // restore the full time stamp (core1 reports within VBLSYNC_MAX_AGE)
+        mouseVblEdge(Now - (uint16_t)(Now - Stamp), Now, VblTime, Interval, Cycles);
+    }
+}
+
+#if (defined(FEATURE_REGION_DETECT))||(defined(FEATURE_VBL_TIMER))
+/** Measure the bus clock with the first screen refreshes after power-up, which tells PAL from NTSC machines,
+ *  and whether bus cycles are video time at all. Usually done long before the Apple II has booted, so the
+ *  VBL IRQs are at the right rate right away. */
+static void mouseControllerBusClock(void)
+{
+    uint32_t IrqStatus = save_and_disable_interrupts();
+    uint32_t VblEvents = A2_VBL_EVENTS();
+    uint32_t Interval  = A2_VBL_INTERVAL();
+    uint32_t Cycles    = A2_VBL_CYCLES();
+    restore_interrupts(IrqStatus);
+
+    if (VblEvents == BusClock.LastEvents)
+        return;
+    BusClock.LastEvents = VblEvents;
+
+    // no interval after a restart
+    if (!Interval)
+        return;
+
+    BusClock.Cycles += Cycles;
+    BusClock.Time   += Interval;
+    if (++BusClock.Frames < BUSCLOCK_FRAMES)
+        return;
+
+    uint32_t Clock = (((uint64_t) BusClock.Cycles) * A2_TIMESTAMP_HZ) / BusClock.Time;
+    BusClock.Frames = BusClock.Cycles = BusClock.Time = 0;
+    Diag.BusClock = Clock;
+    if ((Clock < BUSCLOCK_PAL-BUSCLOCK_TOLERANCE)||(Clock > BUSCLOCK_NTSC+BUSCLOCK_TOLERANCE))
+    {
+        // measure again, unless the unusual clock was confirmed
+        if (++BusClock.Foreign < BUSCLOCK_FOREIGN)
+            return;
+        BusClock.Done = true;
+#ifdef FEATURE_VBL_TIMER
+        // bus cycles aren't video time: VBL events are timed instead, for the current period
+        VblSource.Timed = true;
+        mouseVblPeriod((Mouse.Vbl50HzMode) ? VBL_BUSCYCLES_50HZ : VBL_BUSCYCLES_60HZ);
+#endif
+        return;
+    }
+
+    BusClock.Done = true;
+#ifdef FEATURE_REGION_DETECT
+    VblDefaultPeriod = (Clock < (BUSCLOCK_PAL+BUSCLOCK_NTSC)/2) ? VBL_BUSCYCLES_50HZ : VBL_BUSCYCLES_60HZ;
+
+    // switch, unless the Apple II already selected the rate
+    if ((!Mouse.VblTimeSet)&&(VblDefaultPeriod != VBL_BUSCYCLES_DEFAULT))
+    {
+        Mouse.Vbl50HzMode = (VblDefaultPeriod == VBL_BUSCYCLES_50HZ);
+        mouseVblPeriod(VblDefaultPeriod);
+    }
+#endif
+}
+#endif
+
+#ifdef A2_VBL_COUNTER
+/** Restore the default VBL period after a 6502 reset (core0). */
+static void mouseVblReset(void)
+{
+    VblResetPending = false;
+    // reset number of cycles per screen
+    Mouse.Vbl50HzMode = (VblDefaultPeriod == VBL_BUSCYCLES_50HZ);
+    mouseVblPeriod(VblDefaultPeriod);
+    // no VBL event pending
+    Mouse.LastVblEvents = A2_VBL_EVENTS();
+}
+#endif
+
 void mouseControllerRun(void)
 {
-    uint8_t PortB = PIA6520_PORTB();
     static uint8_t OldInt = 0;
 
-    // any write operations?
-    if ((PortB ^ Mouse.LastPortB) & PIA_PORTB_WRREQUEST)
+#ifdef A2_VBL_COUNTER
+    // a 6502 reset, before any of the commands which followed it
+    if (VblResetPending)
+        mouseVblReset();
+#endif
+
+    // process command bytes (already acknowledged by core1)
+    while (!spscQueueEmpty(&MouseEvents))
     {
-        mouseControllerWrite(PortB);
+        // clears pending output data
+        Mouse.ReadPos = 0;
+        mouseControllerAcceptData(spscQueuePeek(&MouseEvents));
+        // hand the reply to core1, which does not access it while the byte is queued
+        memcpy(Core1Reply.Buffer, Mouse.ReadBuffer, sizeof(Core1Reply.Buffer));
+        Core1Reply.Pos = Mouse.ReadPos;
+        // release the byte only when it was processed
+        spscQueuePop(&MouseEvents);
     }
 
-    // process read requests
-    mouseControllerRead(PortB);
-    Mouse.LastPortB = PortB;
+    // first reply byte: core1 only serves the subsequent ones
+    if (((PIA6520_PORTB() & (PIA_PORTB_WRACK|PIA_PORTB_WRREQUEST|PIA_PORTB_RDACK)) == 0)&&
+        ((Pia.IB & PIA_PORTB_RDREADY) == 0))
+    {
+        uint32_t IrqStatus = spin_lock_blocking(spin_lock_instance(PIA_SPINLOCK_ID));
+        mouseControllerReadReady(PIA6520_PORTB());
+        spin_unlock(spin_lock_instance(PIA_SPINLOCK_ID), IrqStatus);
+    }
+
+#if (defined(FEATURE_REGION_DETECT))||(defined(FEATURE_VBL_TIMER))
+    if (!BusClock.Done)
+        mouseControllerBusClock();
+#endif
+
+#ifdef FEATURE_VBL_TIMER
+    // switch the VBL source on core0, which receives its interrupts
+    uint32_t VblClock = VblSource.Clock;
+    if (VblClock != VblSource.Applied)
+    {
+        VblSource.Applied = VblClock;
+        A2_VBL_TIMER(VblClock);
+    }
+#endif
+
+    mouseControllerVblSync();
 
     // briefly block interrupts while we do the bus cycle counter check
     uint32_t IrqStatus = save_and_disable_interrupts();
@@ -666,6 +1215,11 @@ void mouseControllerRun(void)
             {
                 IRQ_ASSERT();
             }
+            // count the newly raised interrupt sources
+            uint8_t Raised = Mouse.IntState & ~OldInt;
+            Diag.IrqVbl      += (Raised & STATUS_IRQ_VBL) ? 1 : 0;
+            Diag.IrqMovement += (Raised & STATUS_IRQ_MOVEMENT) ? 1 : 0;
+            Diag.IrqButton   += (Raised & STATUS_IRQ_BUTTON) ? 1 : 0;
         }
         OldInt = Mouse.IntState;
     }
@@ -683,17 +1237,25 @@ void __time_critical_func(mouseControllerReset)(void)
     }
     Mouse.Clamp.MaxX = 1023;
     Mouse.Clamp.MaxY = 1023;
-#ifdef PLATFORM_A2VGA
-    // reset number of cycles per screen
-    VblCycleCount = VBL_BUSCYCLES_DEFAULT;
-    // reset cycle counter
-    Mouse.LastBusCycleCounter = 0;
+    Core1LastPortB = 0;
+    Core1Reply.Pos = 0;
+    // MouseEvents is left alone: core0 may be draining the queue right now
+#ifdef A2_VBL_COUNTER
+    // the VBL state is owned by core0, which restores the default period
+    VblResetPending = true;
 #endif
 }
 
 void mouseControllerInit(void)
 {
+    // reserve the spin lock, so the SDK never hands it out dynamically
+    spin_lock_claim(PIA_SPINLOCK_ID);
+    latencyClear(&MouseLatency);
+    latencyClear(&MouseReportInterval);
     mouseControllerReset();
+#ifdef A2_VBL_COUNTER
+    mouseVblReset();
+#endif
 }
 
 #endif // FUNCTION_MOUSE
@@ -28,6 +28,50 @@
 #ifdef FUNCTION_MOUSE
 
 #include "PIA6520.h"
+#include "util/vblsync.h"
+#include "util/latency.h"
+
+/* Read-only diagnostics window for RDMEMMOUSE at addresses unused by the 6805:
+ * firmware version, USB, VBL, IRQ and latency counters (see TMouseDiagnostics). */
+/** Base address of the diagnostics window. Reading the first byte takes a snapshot of all
+ *  counters, so multi-byte values read from the following addresses are consistent. */
+#define DIAG_RDMEM_BASE         0x0800
+#define DIAG_LAYOUT_VERSION     1
+
+/* Diagnostics flags */
+#define DIAG_FLAG_PROFILER      (1<<0) /* profiler histograms at PROFILER_RDMEM_BASE */
+#define DIAG_FLAG_LATENCY       (1<<1) /* report and latency counters are valid */
+#define DIAG_FLAG_VBL_50HZ      (1<<2) /* VBL interrupts at the PAL rate */
+#define DIAG_FLAG_VBL_LOCKED    (1<<3) /* VBL interrupts are phase locked to the video */
+#define DIAG_FLAG_ACCEL         (1<<4) /* pointer acceleration is enabled */
+#define DIAG_FLAG_PHASE0_SHORT  (1<<5) /* phase 0 too short: read data is output late */
+
+/** Layout of the diagnostics window: little-endian, counters wrap around. Times are in
+ *  microseconds (bus cycles in the host simulator). */
+typedef struct
+{
+    uint8_t  Layout;        /**< 0x00: DIAG_LAYOUT_VERSION */
+    uint8_t  Size;          /**< 0x01: size of the window in bytes */
+    uint8_t  Flags;         /**< 0x02: DIAG_FLAG_* */
+    uint8_t  UsbDevices;    /**< 0x03: number of USB devices with HID interfaces */
+    char     Version[12];   /**< 0x04: firmware version (ASCII, zero padded) */
+    uint32_t Reports;       /**< 0x10: number of USB mouse reports */
+    uint32_t ReportRate;    /**< 0x14: USB mouse reports per second while moving (median interval) */
+    uint32_t VblPeriod;     /**< 0x18: bus cycles per VBL interrupt */
+    uint32_t VblEvents;     /**< 0x1C: number of screen refreshes */
+    uint32_t BusClock;      /**< 0x20: measured bus clock in Hz (0: not measured) */
+    uint32_t IrqVbl;        /**< 0x24: VBL interrupts raised */
+    uint32_t IrqMovement;   /**< 0x28: movement interrupts raised */
+    uint32_t IrqButton;     /**< 0x2C: button interrupts raised */
+    uint32_t Dropped;       /**< 0x30: port B events dropped by core1 (queue was full) */
+    uint32_t LatencyCount;  /**< 0x34: reports read by READMOUSE */
+    uint32_t LatencyMin;    /**< 0x38: time from a USB report until READMOUSE: minimum */
+    uint32_t LatencyAvg;    /**< 0x3C: average */
+    uint32_t LatencyP99;    /**< 0x40: 99th percentile (upper bound) */
+    uint32_t LatencyMax;    /**< 0x44: maximum */
+    uint32_t Phase0;        /**< 0x48: shortest phase 0 (PHI0 high) in ns, measured at startup (0: not measured) */
+    uint32_t ReadAdvance;   /**< 0x4C: read data is output this many ns earlier than the default timing */
+} TMouseDiagnostics;
 
 /** Initialization at startup */
 extern void mouseControllerInit         (void);
@@ -38,8 +82,29 @@ extern void mouseControllerReset        (void);
 /** Loop / Run method to process slave commands */
 extern void mouseControllerRun          (void);
 
+/** Called by core1 after each write to PIA port B (with the PIA spin lock held) */
+extern void mouseControllerPortB        (void);
+
+/** $C019 polling loops, snooped by core1 */
+extern TVblSnoop VblSnoop;
+
 /** Report new mouse movement */
-extern void mouseControllerMoveXY       (int8_t X, int8_t Y);
+extern void mouseControllerMoveXY       (int16_t X, int16_t Y);
+
+/** Enable/disable pointer acceleration (at startup: enabled by FUNCTION_POINTER_ACCEL builds), otherwise motion is 1:1 */
+extern void mouseControllerAccel        (bool Enable);
+
+/** Time from a USB mouse report until the 6502 read its motion (READMOUSE) */
+extern TLatencyStats MouseLatency;
+
+/** Time in between USB mouse reports */
+extern TLatencyStats MouseReportInterval;
+
+/** A USB mouse report arrived at the given time (A2_TIMESTAMP), called before its motion is reported */
+extern void mouseControllerReportTime   (uint32_t Time);
+
+/** Number of USB devices with HID interfaces changed */
+extern void mouseControllerUsbDevices   (uint8_t Count);
 
 /** Report new button press/release */
 extern void mouseControllerUpdateButton (uint8_t ButtonNr, bool Pressed);
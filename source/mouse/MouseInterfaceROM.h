@@ -1,6 +1,7 @@
 // Apple II Mouse Interface Card Slot ROM - 2KB, paged in 8x256 bytes
 // **This needs to be in **RAM** (access performance).**
-uint8_t MouseInterfaceROM[] = {
+// Pages are 256 byte aligned, so the PIO+DMA slot ROM engine (A2_ROM_ENGINE) can address them directly.
+uint8_t CORE1_DATA(MouseInterfaceROM)[] __attribute__((aligned(256))) = {
   0x2c, 0x58, 0xff, 0x70, 0x1b, 0x38, 0x90, 0x18, 0xb8, 0x50, 0x15, 0x01,
   0x20, 0xf4, 0xf4, 0xf4, 0xf4, 0x00, 0xb3, 0xc4, 0x9b, 0xa4, 0xc0, 0x8a,
   0xdd, 0xbc, 0x48, 0xf0, 0x53, 0xe1, 0xe6, 0xec, 0x08, 0x78, 0x8d, 0xf8,
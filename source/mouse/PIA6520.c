@@ -63,6 +63,10 @@
  * We can keep this feature disabled entirely, improving performance. */
 #define FEATURE_DISABLE_PIA_IRQS
 
+#ifndef FEATURE_DISABLE_PIA_IRQS
+  #error The PIA read image requires FEATURE_DISABLE_PIA_IRQS (reading CRA/CRB clears the IRQ flags).
+#endif
+
 /* PIA6520 IRQ flags */
 #define PIA_IRQ1  0x80 /**< CA1/CB1 state */
 #define PIA_IRQ2  0x40 /**< CA2/CB2 state */
@@ -77,18 +81,22 @@
 #define CLAMP_ADDRESS(address) { address &= 0x3; }
 
 /** Internal state of the PIA registers */ 
-T6520 Pia;
+T6520 CORE1_DATA(Pia);
 
 /** Initialize the PIA module at startup. */
 static void __time_critical_func(PIA6520_init)(void)
 {
     // wipe internal state
     //memset(&Pia, 0, sizeof(Pia));
+    uint32_t IrqStatus = spin_lock_blocking(spin_lock_instance(PIA_SPINLOCK_ID));
     *((uint64_t*)&Pia) = 0;
     *((uint16_t*)&Pia.IA) = 0;
 #ifndef FEATURE_DISABLE_PIA_IRQS
     *((uint16_t*)&Pia.IRQA) = 0;
 #endif
+    // all registers are 0 after reset
+    *((uint32_t*)Pia.ReadImage) = 0;
+    spin_unlock(spin_lock_instance(PIA_SPINLOCK_ID), IrqStatus);
 }
 
 #ifndef FEATURE_DISABLE_PIA_IRQS
@@ -119,6 +127,7 @@ void __time_critical_func(PIA6520_write)(uint32_t address, uint8_t data)
 {
     CLAMP_ADDRESS(address);
     //DEBUG_PRINT("PIA WRITE: %02x = %02x\n", address, data);
+    PIA6520_IMAGE_LOCK();
     switch (address)
     {
         case 0:
@@ -126,6 +135,7 @@ void __time_critical_func(PIA6520_write)(uint32_t address, uint8_t data)
                 Pia.ORA  = data;
             else
                 Pia.DDRA = data;
+            PIA6520_IMAGE_A();
             break;
         case 1:
             // CA1/CA2 bits in control register are read-only
@@ -134,12 +144,15 @@ void __time_critical_func(PIA6520_write)(uint32_t address, uint8_t data)
         #ifndef FEATURE_DISABLE_PIA_IRQS
             data |= Pia.IRQA;
         #endif
+            PIA6520_IMAGE_A();
+            PIA6520_IMAGE_CRA();
             break;
         case 2:
             if (Pia.CRB & 0x04)
                 Pia.ORB = data;
             else
                 Pia.DDRB = data;
+            PIA6520_IMAGE_B();
             break;
         case 3:
             // CB1/CB2 bits in control register are read-only
@@ -148,8 +161,11 @@ void __time_critical_func(PIA6520_write)(uint32_t address, uint8_t data)
         #ifndef FEATURE_DISABLE_PIA_IRQS
             data |= Pia.IRQB;
         #endif
+            PIA6520_IMAGE_B();
+            PIA6520_IMAGE_CRB();
             break;
     }
+    PIA6520_IMAGE_UNLOCK();
 }
 
 /** Read a PIA register. Normal read - calculated on the fly... */
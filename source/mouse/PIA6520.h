@@ -23,6 +23,18 @@
  *
  */
 
+#pragma once
+
+/* The PIA keeps a precomputed image of its four registers, as seen by 6502 reads.
+ * The image is updated whenever the PIA state changes (which is rare), so
+ * the time critical 6502 read cycles only need a single memory load. */
+
+#ifdef PICO_BUILD
+  #include <hardware/sync.h>
+#endif
+/** Hardware spin lock protecting the read image (updated by core0 and core1). */
+#define PIA_SPINLOCK_ID 30
+
 /** PIA6520 internal register states */
 typedef struct
 {
@@ -32,7 +44,10 @@ typedef struct
   volatile uint8_t ORB;  /**< output register B */
   volatile uint8_t CRA;  /**< control register A */
   volatile uint8_t CRB;  /**< control register B */
-  
+
+  /** register values for 6502 reads: PIBA, CRA, PIBB, CRB */
+  volatile uint8_t ReadImage[4] __attribute__((aligned(4)));
+
   volatile uint64_t spacer; /**< spacer, separate Core 0+1 mem area */
   
   volatile uint8_t IA;  /**< input data port A */
@@ -53,30 +68,65 @@ extern T6520 Pia;
 /** Read current PORTB output port (the physical output) */
 #define PIA6520_PORTB() ((Pia.ORB & Pia.DDRB)|(Pia.IB & ~Pia.DDRB))
 
+/** Update the read image of register 0 (PIBA). Requires the spin lock. */
+#define PIA6520_IMAGE_A() Pia.ReadImage[0] = (Pia.CRA & 0x04) ? PIA6520_PORTA() : Pia.DDRA
+/** Update the read image of register 2 (PIBB). Requires the spin lock. */
+#define PIA6520_IMAGE_B() Pia.ReadImage[2] = (Pia.CRB & 0x04) ? PIA6520_PORTB() : Pia.DDRB
+/** Update the read image of register 1 (CRA). Requires the spin lock. */
+#define PIA6520_IMAGE_CRA() Pia.ReadImage[1] = Pia.CRA
+/** Update the read image of register 3 (CRB). Requires the spin lock. */
+#define PIA6520_IMAGE_CRB() Pia.ReadImage[3] = Pia.CRB
+
+/** Lock the read image from core1's bus loop (interrupts are never enabled on core1). */
+#define PIA6520_IMAGE_LOCK()   spin_lock_unsafe_blocking(spin_lock_instance(PIA_SPINLOCK_ID))
+#define PIA6520_IMAGE_UNLOCK() spin_unlock_unsafe(spin_lock_instance(PIA_SPINLOCK_ID))
+
 /** Provide new input data for external port A */
-#define PIA6520_inputA(data) Pia.IA = data
+static inline void PIA6520_inputA(uint8_t data)
+{
+    // core0: interrupts must not delay core1 while we're holding the lock
+    uint32_t IrqStatus = spin_lock_blocking(spin_lock_instance(PIA_SPINLOCK_ID));
+    Pia.IA = data;
+    PIA6520_IMAGE_A();
+    spin_unlock(spin_lock_instance(PIA_SPINLOCK_ID), IrqStatus);
+}
+
 /** Provide new input data for external port B */
-#define PIA6520_inputB(data) Pia.IB = data;
+static inline void PIA6520_inputB(uint8_t data)
+{
+    uint32_t IrqStatus = spin_lock_blocking(spin_lock_instance(PIA_SPINLOCK_ID));
+    Pia.IB = data;
+    PIA6520_IMAGE_B();
+    spin_unlock(spin_lock_instance(PIA_SPINLOCK_ID), IrqStatus);
+}
 
 void    PIA6520_write(uint32_t address, uint8_t data);
 uint8_t PIA6520_read (uint16_t address);
 
 #define PIA6520_fastwrite(address, data)\
 { \
+    PIA6520_IMAGE_LOCK();\
     switch (address&3)\
     {\
         case 0:\
             if (Pia.CRA & 0x04) Pia.ORA  = data;else Pia.DDRA = data;\
+            PIA6520_IMAGE_A();\
             break;\
         case 1:\
             Pia.CRA  = data & 0x3f;\
+            PIA6520_IMAGE_A();\
+            PIA6520_IMAGE_CRA();\
             break;\
         case 2:\
             if (Pia.CRB & 0x04) Pia.ORB = data;else Pia.DDRB = data;\
+            PIA6520_IMAGE_B();\
             break;\
         case 3:\
             Pia.CRB  = data & 0x3f;\
+            PIA6520_IMAGE_B();\
+            PIA6520_IMAGE_CRB();\
             break;\
     }\
+    PIA6520_IMAGE_UNLOCK();\
 }
     
@@ -1,153 +1,252 @@
-/* 
- * The MIT License (MIT)
- *
- * Copyright (c) 2024 Thorsten Brehm
- *
- * Permission is hereby granted, free of charge, to any person obtaining a copy
- * of this software and associated documentation files (the "Software"), to deal
- * in the Software without restriction, including without limitation the rights
- * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
- * copies of the Software, and to permit persons to whom the Software is
- * furnished to do so, subject to the following conditions:
- *
- * The above copyright notice and this permission notice shall be included in
- * all copies or substantial portions of the Software.
- *
- * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
- * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
- * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
- * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
- * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
- * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
- * THE SOFTWARE.
- *
- */
-
-#include <string.h>
-#include "a2platform.h"
-#include "usb/usb.h"
-
-#ifdef FUNCTION_MOUSE
-  #include "mouse/MouseInterfaceCard.h"
-#endif
-
-#ifdef FUNCTION_LOGGING
-uint32_t LogCounter = 0; // position of recording 
-uint32_t LogOffset  = 0; // position of viewer
-uint32_t LogTrigger = 0; // trigger state (0=OFF, 1=waiting, 2=recording)
-#endif
-
-/** The offset to the currently seleced page in the MouseInterface SlotROM. */
-uint32_t ROMOffset = 0;
-
-#ifdef FUNCTION_ROM_WRITE
-/** Debug switch to allow writing to SlotROM for debugging. */
-uint8_t  ROMWriteEnable = 0;
-#endif
-
-#ifdef FUNCTION_PROFILER
-extern uint32_t ProfilerMaxTime;
-#endif
-
-void __time_critical_func(usb_buswrite)(uint32_t address, uint32_t value)
-{
-#ifdef FUNCTION_MOUSE
-    if(A2_IS_DEVSEL(address))
-    {
-  #ifdef FUNCTION_LOGGING
-        if ((address&0x7)==7)
-        {
-           value &= 0xff;
-           if (value == 0xFF)
-           {
-             LogCounter = 0;
-             LogTrigger = 1;
-           }
-           else
-           if (value >= 0xFC)
-           {
-               LogTrigger = (value&0x3);
-           }
-  #ifdef FUNCTION_ROM_WRITE
-           else
-           if (value == 0xAA)
-           {
-               ROMWriteEnable = 1;
-           }
-  #endif // FUNCTION_ROM_WRITE
-           else
-           if (LogCounter)
-           {
-             LogTrigger = 0;
-             LogOffset  = (value << 8)|(0x10000);
-           }
-        }
-        else
-  #endif // FUNCTION_LOGGING
-        {
-          // PIA registers are being written
-          // PIA6520_fastwrite(address,value);
-          // code just inlined here - so we can add debug hooks...
-          switch (address&3)
-          {
-            case 0:
-                if (Pia.CRA & 0x04) Pia.ORA = value;else Pia.DDRA = value;
-                break;
-            case 1:
-                Pia.CRA  = value & 0x3f;
-                break;
-            case 2:
-                if (Pia.CRB & 0x04) Pia.ORB = value;else Pia.DDRB = value;
-                // prepare ROMOffset - so we don't need to do that in a tight read-cycle
-                ROMOffset = ((Pia.ORB & Pia.DDRB & 0x0E)<<7);
-  #ifdef FUNCTION_LOGGING
-                // special log event when the SlotROM page was switched
-                if ((LogTrigger==2) && ((LogCounter & 0x4000)==0))
-                  LogMemory[LogCounter++] = 0xffff00ff | ROMOffset;
-  #endif
-                break;
-            case 3:
-                Pia.CRB  = value & 0x3f;
-                break;
-          }
-        }
-    }
- #if FUNCTION_ROM_WRITE // ROM Write Enable
-    else
-    if (A2_IS_IOSEL(address))
-    {
-        // we ignore WRITEs to the ROM area for now (we may add config update support later)
-        if (ROMWriteEnable)
-        {
-          MOUSE_INTERFACE_PROGRAM_ROM(address, value);
-        }
-    }
- #endif // FUNCTION_ROM_WRITE
-#endif // FUNCTION_MOUSE
-}
-
-uint8_t __time_critical_func(usb_busread)(uint32_t address)
-{
-#ifdef FUNCTION_MOUSE
-    // our slot's DEVSELECT or IOSELECT is active
-    if(A2_IS_DEVSEL(address))
-    {
-        // PIA registers are being read
-        A2_PUSHDATA(PIA6520_read(address));
-    }
-    else
-    if (A2_IS_IOSEL(address))
-    {
-        address &= 0xff;
- #ifdef FUNCTION_LOGGING
-        if (LogOffset)
-        {
-          address |= (LogOffset&0xffff);
-          A2_PUSHDATA((address<(LogCounter<<2)) ? ((uint8_t*)LogMemory)[address] : 0);
-          return;
-        }
- #endif
-        A2_PUSHDATA(MouseInterfaceROM[address | ROMOffset]);
-    }
-#endif
-}
+/* 
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2024 Thorsten Brehm
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <string.h>
+#include "a2platform.h"
+#include "dma/dmacopy.h"
+#include "usb/usb.h"
+#include "util/profiler.h"
+#include "util/doorbell.h"
+#include "util/interpdecode.h"
+
+#ifdef FUNCTION_MOUSE
+  #include "mouse/MouseInterfaceCard.h"
+#endif
+
+#if defined(A2_ROM_ENGINE) && defined(FUNCTION_LOGGING)
+  #error The slot ROM engine cannot be combined with FUNCTION_LOGGING (the log viewer uses the slot ROM area).
+#endif
+
+#ifdef FUNCTION_LOGGING
+uint32_t LogCounter = 0; // position of recording 
+uint32_t LogOffset  = 0; // position of viewer
+uint32_t LogTrigger = 0; // trigger state (0=OFF, 1=waiting, 2=recording)
+#endif
+
+/** The offset to the currently seleced page in the MouseInterface SlotROM. */
+uint32_t CORE1_DATA(ROMOffset) = 0;
+
+#ifdef FUNCTION_ROM_WRITE
+/** Debug switch to allow writing to SlotROM for debugging. */
+uint8_t  ROMWriteEnable = 0;
+#endif
+
+void CORE1_CODE(usb_buswrite)(uint32_t address, uint32_t value)
+{
+#ifdef FUNCTION_MOUSE
+    if(A2_IS_DEVSEL(address))
+    {
+  #ifdef FUNCTION_LOGGING
+        if ((address&0x7)==7)
+        {
+           value &= 0xff;
+           if (value == 0xFF)
+           {
+             LogCounter = 0;
+             LogTrigger = 1;
+           }
+           else
+           if (value >= 0xFC)
+           {
+               LogTrigger = (value&0x3);
+           }
+  #ifdef FUNCTION_ROM_WRITE
+           else
+           if (value == 0xAA)
+           {
+               ROMWriteEnable = 1;
+           }
+  #endif // FUNCTION_ROM_WRITE
+           else
+           if (LogCounter)
+           {
+             LogTrigger = 0;
+             LogOffset  = (value << 8)|(0x10000);
+           }
+        }
+        else
+  #endif // FUNCTION_LOGGING
+        {
+          // PIA registers are being written
+          // PIA6520_fastwrite(address,value);
+          // code just inlined here - so we can add debug hooks...
+          PIA6520_IMAGE_LOCK();
+          switch (address&3)
+          {
+            case 0:
+                if (Pia.CRA & 0x04) Pia.ORA = value;else Pia.DDRA = value;
+                PIA6520_IMAGE_A();
+                break;
+            case 1:
+                Pia.CRA  = value & 0x3f;
+                PIA6520_IMAGE_A();
+                PIA6520_IMAGE_CRA();
+                break;
+            case 2:
+                if (Pia.CRB & 0x04) Pia.ORB = value;else Pia.DDRB = value;
+                PIA6520_IMAGE_B();
+                // pass the port B write to the mouse controller right away
+                mouseControllerPortB();
+                // prepare ROMOffset - so we don't need to do that in a tight read-cycle
+                ROMOffset = ((Pia.ORB & Pia.DDRB & 0x0E)<<7);
+                INTERP_DECODE_ROMPAGE(&MouseInterfaceROM[ROMOffset]);
+  #ifdef A2_ROM_ENGINE
+                A2_ROM_ENGINE_PAGE(&MouseInterfaceROM[ROMOffset]);
+  #endif
+  #ifdef FUNCTION_LOGGING
+                // special log event when the SlotROM page was switched
+                if ((LogTrigger==2) && ((LogCounter & 0x4000)==0))
+                  LogMemory[LogCounter++] = 0xffff00ff | ROMOffset;
+  #endif
+                break;
+            case 3:
+                Pia.CRB  = value & 0x3f;
+                PIA6520_IMAGE_B();
+                PIA6520_IMAGE_CRB();
+                break;
+          }
+          PIA6520_IMAGE_UNLOCK();
+        }
+    }
+ #if FUNCTION_ROM_WRITE // ROM Write Enable
+    else
+    if (A2_IS_IOSEL(address))
+    {
+        // we ignore WRITEs to the ROM area for now (we may add config update support later)
+        if (ROMWriteEnable)
+        {
+          MOUSE_INTERFACE_PROGRAM_ROM(address, value);
+        }
+    }
+ #endif // FUNCTION_ROM_WRITE
+#endif // FUNCTION_MOUSE
+}
+
+void CORE1_CODE(usb_busread)(uint32_t address)
+{
+#ifdef FUNCTION_MOUSE
+    // our slot's DEVSELECT or IOSELECT is active
+    if(A2_IS_DEVSEL(address))
+    {
+        // PIA registers are being read
+        A2_PUSHDATA(INTERP_DECODE_REGISTER());
+    }
+#ifndef A2_ROM_ENGINE // otherwise slot ROM reads never reach core1
+    else
+    if (A2_IS_IOSEL(address))
+    {
+        address &= 0xff;
+ #ifdef FUNCTION_LOGGING
+        if (LogOffset)
+        {
+          address |= (LogOffset&0xffff);
+          A2_PUSHDATA((address<(LogCounter<<2)) ? ((uint8_t*)LogMemory)[address] : 0);
+          return;
+        }
+ #endif
+        A2_PUSHDATA(INTERP_DECODE_ROM());
+    }
+#endif // A2_ROM_ENGINE
+#endif
+}
+
+void __time_critical_func(usb_reset)(void)
+{
+    // Reset when the Apple II resets
+    mouseControllerReset();
+    ROMOffset = 0;
+#ifdef FUNCTION_MOUSE
+    INTERP_DECODE_ROMPAGE(&MouseInterfaceROM[0]);
+  #ifdef A2_ROM_ENGINE
+    A2_ROM_ENGINE_PAGE(&MouseInterfaceROM[0]);
+  #endif
+#endif
+
+#ifdef FUNCTION_LOGGING
+    // stop logging on 6502 HW reset
+    LogTrigger = 0;
+#endif
+
+    // restart profiling on 6502 HW reset
+    PROFILER_CLEAR();
+}
+
+/** Core1 setup, before processing any bus cycles. */
+void usb_core1_init(void)
+{
+#ifdef FUNCTION_MOUSE
+    // the interpolators are per-core: core1 needs to configure its own
+    INTERP_DECODE_INIT(&MouseInterfaceROM[ROMOffset], Pia.ReadImage);
+  #ifdef A2_ROM_ENGINE
+    A2_ROM_ENGINE_INIT(&MouseInterfaceROM[ROMOffset]);
+  #endif
+#endif
+}
+
+/** Process a single 6502 bus cycle. Returns the bus interface path (PROFILER_PATH_*) which was taken. */
+static __always_inline uint32_t usb_buscycle(uint32_t value, uint32_t address)
+{
+    uint32_t Path = PROFILER_PATH_IDLE;
+
+    if(A2_IS_SELECT(address))
+    {
+        if(A2_IS_ACCESS_READ(address))
+        {
+            INTERP_DECODE_INPUT(value);
+            usb_busread(address);
+            Path = (A2_IS_DEVSEL(address)) ? PROFILER_PATH_DEVSEL_READ : PROFILER_PATH_IOSEL_READ;
+        }
+        else
+        {
+            usb_buswrite(address, value);
+            Path = (A2_IS_DEVSEL(address)) ? PROFILER_PATH_DEVSEL_WRITE : PROFILER_PATH_IOSEL_WRITE;
+        }
+    }
+#ifdef A2_SNOOP_BUS
+    else
+    {
+        if (A2_IS_RESET(value))
+        {
+            usb_reset();
+            Path = PROFILER_PATH_RESET;
+        }
+  #ifdef FUNCTION_MOUSE
+        else
+        if ((address == VBLSYNC_RDVBLBAR)&&(A2_IS_ACCESS_READ(value)))
+        {
+            // software waiting for the video scanner
+            vblSyncSnoop(&VblSnoop, A2_TIMESTAMP());
+        }
+        else
+        if (VblSnoop.Pending)
+        {
+            // the branch instruction of the polling loop
+            vblSyncLoop(&VblSnoop, address);
+        }
+  #endif
+    }
+#endif
+    return Path;
+}
@@ -24,9 +24,12 @@
  *
  */
 
+#include <string.h>
 #include "bsp/board.h"
 #include "tusb.h"
 #include <hardware/pio.h>
+#include <hardware/timer.h>
+#include "usb/hid_mouse.h"
 
 #ifdef FUNCTION_MOUSE
   #include "mouse/MouseInterfaceCard.h"
@@ -40,16 +43,48 @@
 
 static uint8_t const keycode2ascii[128][2] =  { HID_KEYCODE_TO_ASCII };
 
-// Each HID instance can has multiple reports
-static struct
+// device addresses assigned by TinyUSB: 1..CFG_TUH_DEVICE_MAX (+hubs)
+#define HID_MAX_ADDR  (CFG_TUH_DEVICE_MAX + CFG_TUH_HUB)
+
+// State of a mounted HID interface. Each HID instance can has multiple reports.
+typedef struct
 {
+  bool    mounted;
   uint8_t report_count;
   tuh_hid_report_info_t report_info[MAX_REPORT];
-} hid_info[CFG_TUH_HID];
+  THidMouseLayout mouse;              // input report layout of mice (report protocol)
+  uint8_t mouse_buttons;              // buttons currently pressed on this device
+  hid_keyboard_report_t prev_kbd;     // previous report to check key released
+} hid_state_t;
+
+// TinyUSB supports CFG_TUH_HID interfaces in total (over all devices)
+static hid_state_t hid_state[CFG_TUH_HID];
+
+// slot of each (device address, instance) in hid_state, 0: not mounted, otherwise slot+1
+static uint8_t hid_slot[HID_MAX_ADDR+1][CFG_TUH_HID];
 
-static void process_kbd_report(hid_keyboard_report_t const *report);
-static void process_mouse_report(hid_mouse_report_t const * report);
-static void process_generic_report(uint8_t dev_addr, uint8_t instance, uint8_t const* report, uint16_t len);
+// buttons of all mice, combined
+static uint8_t mouse_buttons = 0;
+
+// mice with a parsed report descriptor are switched to report protocol, for deltas beyond +-127.
+// Keyboards stay in boot protocol, which process_kbd_report expects. (requires TinyUSB 0.15)
+#if (TUSB_VERSION_MAJOR > 0)||(TUSB_VERSION_MINOR >= 15)
+  #define HID_REPORT_PROTOCOL
+#endif
+
+static void process_kbd_report(hid_state_t* hid, hid_keyboard_report_t const *report);
+static void process_mouse_report(hid_state_t* hid, THidMouseLayout const* layout, uint8_t const* report, uint16_t len, uint32_t time);
+static void process_generic_report(hid_state_t* hid, uint8_t const* report, uint16_t len, uint32_t time);
+static void update_mouse_buttons(void);
+static void update_usb_devices(void);
+
+// state of a mounted HID interface, NULL if unknown
+static inline hid_state_t* hid_get_state(uint8_t dev_addr, uint8_t instance)
+{
+  if ((dev_addr > HID_MAX_ADDR)||(instance >= CFG_TUH_HID)||(!hid_slot[dev_addr][instance]))
+    return NULL;
+  return &hid_state[hid_slot[dev_addr][instance]-1];
+}
 
 void hid_app_init(void)
 {
@@ -88,13 +123,38 @@ void tuh_hid_mount_cb(uint8_t dev_addr, uint8_t instance, uint8_t const* desc_re
   printf("HID Interface Protocol = %s\r\n", protocol_str[itf_protocol]);
 #endif
 
-  // By default host stack will use activate boot protocol on supported interface.
-  // Therefore for this simple example, we only need to parse generic report descriptor (with built-in parser)
-  if ( itf_protocol == HID_ITF_PROTOCOL_NONE )
+  // assign a free slot
+  if ((dev_addr > HID_MAX_ADDR)||(instance >= CFG_TUH_HID))
+    return;
+  hid_state_t* hid = hid_get_state(dev_addr, instance);
+  if (!hid)
+  {
+    uint8_t slot;
+    for (slot=0; (slot<CFG_TUH_HID)&&(hid_state[slot].mounted); slot++);
+    if (slot == CFG_TUH_HID)
+      return;
+    hid = &hid_state[slot];
+    hid_slot[dev_addr][instance] = slot+1;
+  }
+  memset(hid, 0, sizeof(*hid));
+  hid->mounted = true;
+  update_usb_devices();
+
+  // Generic interfaces and mice (in report protocol) need the parsed report descriptor.
+  // Keyboard reports are assumed to follow the boot layout.
+  if ( itf_protocol != HID_ITF_PROTOCOL_KEYBOARD )
   {
-    hid_info[instance].report_count = tuh_hid_parse_report_descriptor(hid_info[instance].report_info, MAX_REPORT, desc_report, desc_len);
+    hid->report_count = tuh_hid_parse_report_descriptor(hid->report_info, MAX_REPORT, desc_report, desc_len);
+    bool const mouse_parsed = hidMouseParseDescriptor(&hid->mouse, desc_report, desc_len);
 #ifdef DEBUG_OUTPUT
-    printf("HID has %u reports \r\n", hid_info[instance].report_count);
+    printf("HID has %u reports, mouse report %s\r\n", hid->report_count,
+           (mouse_parsed) ? "parsed" : "unknown");
+#endif
+#ifdef HID_REPORT_PROTOCOL
+    // boot mice: full resolution reports, once the device confirmed the switch (tuh_hid_get_protocol),
+    // otherwise they remain in boot protocol
+    if ((itf_protocol == HID_ITF_PROTOCOL_MOUSE)&&(mouse_parsed))
+      tuh_hid_set_protocol(dev_addr, instance, HID_PROTOCOL_REPORT);
 #endif
   }
 
@@ -114,26 +174,79 @@ void tuh_hid_umount_cb(uint8_t dev_addr, uint8_t instance)
 #ifdef DEBUG_OUTPUT
   printf("HID device address = %d, instance = %d is unmounted\r\n", dev_addr, instance);
 #endif
+
+  hid_state_t* hid = hid_get_state(dev_addr, instance);
+  if (!hid)
+    return;
+  hid_slot[dev_addr][instance] = 0;
+  hid->mounted = false;
+  update_usb_devices();
+
+  // release the buttons of a removed mouse
+  if (hid->mouse_buttons)
+  {
+    hid->mouse_buttons = 0;
+    update_mouse_buttons();
+  }
+}
+
+// report the number of devices with mounted HID interfaces (for diagnostics)
+static void update_usb_devices(void)
+{
+#ifdef FUNCTION_MOUSE
+  uint8_t count = 0;
+  for (uint8_t addr=0; addr<=HID_MAX_ADDR; addr++)
+  {
+    for (uint8_t instance=0; instance<CFG_TUH_HID; instance++)
+    {
+      if (hid_slot[addr][instance])
+      {
+        count++;
+        break;
+      }
+    }
+  }
+  mouseControllerUsbDevices(count);
+#endif
 }
 
 // Invoked when received report from device via interrupt endpoint
 void tuh_hid_report_received_cb(uint8_t dev_addr, uint8_t instance, uint8_t const* report, uint16_t len)
 {
+  // microsecond timer (same as A2_TIMESTAMP)
+  uint32_t const time = time_us_32();
   uint8_t const itf_protocol = tuh_hid_interface_protocol(dev_addr, instance);
+  hid_state_t* hid = hid_get_state(dev_addr, instance);
 
-  switch (itf_protocol)
+  switch ((hid) ? itf_protocol : 0xff)
   {
     case HID_ITF_PROTOCOL_KEYBOARD:
-      process_kbd_report( (hid_keyboard_report_t const*) report );
+      process_kbd_report(hid, (hid_keyboard_report_t const*) report );
       break;
 
     case HID_ITF_PROTOCOL_MOUSE:
-      process_mouse_report( (hid_mouse_report_t const*) report );
+      if ((tuh_hid_get_protocol(dev_addr, instance) == HID_PROTOCOL_BOOT)||
+          (hid->mouse.Length == 0))
+      {
+        process_mouse_report(hid, &HidMouseBootLayout, report, len, time);
+      }
+      else
+      if ((hid->mouse.ReportId == 0)||
+          ((len > 0)&&(report[0] == hid->mouse.ReportId)))
+      {
+        // skip the report ID
+        uint8_t const skip = (hid->mouse.ReportId) ? 1 : 0;
+        process_mouse_report(hid, &hid->mouse, report+skip, len-skip, time);
+      }
       break;
 
-    default:
+    case HID_ITF_PROTOCOL_NONE:
       // Generic report requires matching ReportID and contents with previous parsed report info
-      process_generic_report(dev_addr, instance, report, len);
+      process_generic_report(hid, report, len, time);
+      break;
+
+    default:
+      // interface was not mounted
       break;
   }
 
@@ -161,16 +274,16 @@ static inline bool find_key_in_report(hid_keyboard_report_t const *report, uint8
   return false;
 }
 
-static void process_kbd_report(hid_keyboard_report_t const *report)
+static void process_kbd_report(hid_state_t* hid, hid_keyboard_report_t const *report)
 {
-  static hid_keyboard_report_t prev_report = { 0, 0, {0} }; // previous report to check key released
+  hid_keyboard_report_t* const prev_report = &hid->prev_kbd;
 
   //------------- example code ignore control (non-printable) key affects -------------//
   for(uint8_t i=0; i<6; i++)
   {
     if ( report->keycode[i] )
     {
-      if ( find_key_in_report(&prev_report, report->keycode[i]) )
+      if ( find_key_in_report(prev_report, report->keycode[i]) )
       {
         // exist in previous report means the current key is holding
       }else
@@ -187,43 +300,86 @@ static void process_kbd_report(hid_keyboard_report_t const *report)
     // TODO example skips key released
   }
 
-  prev_report = *report;
+  *prev_report = *report;
 }
 
 //--------------------------------------------------------------------+
 // Mouse
 //--------------------------------------------------------------------+
-static void process_mouse_report(hid_mouse_report_t const * report)
+static inline int16_t saturate16(int32_t value)
 {
-  static uint8_t prev_buttons = 0;
+  return (value > INT16_MAX) ? INT16_MAX : (value < INT16_MIN) ? INT16_MIN : value;
+}
 
-  //------------- button state  -------------//
-  uint8_t button_changed_mask = report->buttons ^ prev_buttons;
-  prev_buttons = report->buttons;
+// combine the buttons of all mice, report changes
+static void update_mouse_buttons(void)
+{
+  uint8_t buttons = 0;
+  for (uint8_t slot=0; slot<CFG_TUH_HID; slot++)
+    buttons |= hid_state[slot].mouse_buttons;
+
+  uint8_t button_changed_mask = buttons ^ mouse_buttons;
+  mouse_buttons = buttons;
 
 #ifdef FUNCTION_MOUSE
   // report changes of LEFT button / BUTTON0
   if (button_changed_mask & MOUSE_BUTTON_LEFT)
   {
-    mouseControllerUpdateButton(0,(report->buttons&MOUSE_BUTTON_LEFT)!=0);
+    mouseControllerUpdateButton(0,(buttons&MOUSE_BUTTON_LEFT)!=0);
     #ifdef DEBUG_OUTPUT
-      printf("LEFT: %s\n", ((report->buttons&MOUSE_BUTTON_LEFT)!=0)?"DOWN":"UP");
+      printf("LEFT: %s\n", ((buttons&MOUSE_BUTTON_LEFT)!=0)?"DOWN":"UP");
     #endif
   }
 
   // report changes of RIGHT button / BUTTON1
   if (button_changed_mask & MOUSE_BUTTON_RIGHT)
   {
-    mouseControllerUpdateButton(1,(report->buttons&MOUSE_BUTTON_RIGHT)!=0);
+    mouseControllerUpdateButton(1,(buttons&MOUSE_BUTTON_RIGHT)!=0);
     #ifdef DEBUG_OUTPUT
-      printf("RIGHT: %s\n", ((report->buttons&MOUSE_BUTTON_RIGHT)!=0)?"DOWN":"UP");
+      printf("RIGHT: %s\n", ((buttons&MOUSE_BUTTON_RIGHT)!=0)?"DOWN":"UP");
     #endif
   }
+#endif // FUNCTION_MOUSE
+
+#ifdef DEBUG_OUTPUT
+  if ( button_changed_mask & buttons)
+  {
+    printf(" %c%c%c ",
+       buttons & MOUSE_BUTTON_LEFT   ? 'L' : '-',
+       buttons & MOUSE_BUTTON_MIDDLE ? 'M' : '-',
+       buttons & MOUSE_BUTTON_RIGHT  ? 'R' : '-');
+  }
+#endif // DEBUG_OUTPUT
+}
+
+// report: without report ID
+static void process_mouse_report(hid_state_t* hid, THidMouseLayout const* layout, uint8_t const* report, uint16_t len, uint32_t time)
+{
+  if (len < layout->Length)
+    return;
+
+#ifdef FUNCTION_MOUSE
+  mouseControllerReportTime(time);
+#else
+  (void) time;
+#endif
+
+  uint8_t const buttons = hidFieldGet(&layout->Buttons, report);
+  int16_t const x       = saturate16(hidFieldGet(&layout->X, report));
+  int16_t const y       = saturate16(hidFieldGet(&layout->Y, report));
+
+  //------------- button state  -------------//
+  if (buttons != hid->mouse_buttons)
+  {
+    hid->mouse_buttons = buttons;
+    update_mouse_buttons();
+  }
 
-  // report mouse movement
-  if (report->x || report->y)
+#ifdef FUNCTION_MOUSE
+  // report mouse movement (motion of all mice adds up)
+  if (x || y)
   {
-    mouseControllerMoveXY(report->x, report->y);
+    mouseControllerMoveXY(x, y);
   #if (FUNCTION_LED_MODE==1)&&(!defined FUNCTION_PROFILER)
     static uint8_t toggle=0;
     gpio_put(PICO_DEFAULT_LED_PIN, toggle);
@@ -233,27 +389,17 @@ static void process_mouse_report(hid_mouse_report_t const * report)
 #endif // FUNCTION_MOUSE
 
 #ifdef DEBUG_OUTPUT
-  if ( button_changed_mask & report->buttons)
-  {
-    printf(" %c%c%c ",
-       report->buttons & MOUSE_BUTTON_LEFT   ? 'L' : '-',
-       report->buttons & MOUSE_BUTTON_MIDDLE ? 'M' : '-',
-       report->buttons & MOUSE_BUTTON_RIGHT  ? 'R' : '-');
-  }
-
-  printf("(%d %d %d)\r\n", report->x, report->y, report->wheel);
+  printf("(%d %d %ld)\r\n", x, y, (long) hidFieldGet(&layout->Wheel, report));
 #endif // DEBUG_OUTPUT
 }
 
 //--------------------------------------------------------------------+
 // Generic Report
 //--------------------------------------------------------------------+
-static void process_generic_report(uint8_t dev_addr, uint8_t instance, uint8_t const* report, uint16_t len)
+static void process_generic_report(hid_state_t* hid, uint8_t const* report, uint16_t len, uint32_t time)
 {
-  (void) dev_addr;
-
-  uint8_t const rpt_count = hid_info[instance].report_count;
-  tuh_hid_report_info_t* rpt_info_arr = hid_info[instance].report_info;
+  uint8_t const rpt_count = hid->report_count;
+  tuh_hid_report_info_t* rpt_info_arr = hid->report_info;
   tuh_hid_report_info_t* rpt_info = NULL;
 
   if ( rpt_count == 1 && rpt_info_arr[0].report_id == 0)
@@ -299,12 +445,16 @@ static void process_generic_report(uint8_t dev_addr, uint8_t instance, uint8_t c
     {
       case HID_USAGE_DESKTOP_KEYBOARD:
         // Assume keyboard follow boot report layout
-        process_kbd_report((hid_keyboard_report_t const*) report);
+        process_kbd_report(hid, (hid_keyboard_report_t const*) report);
         break;
 
       case HID_USAGE_DESKTOP_MOUSE:
-        // Assume mouse follow boot report layout
-        process_mouse_report((hid_mouse_report_t const*) report);
+        // use the parsed layout, otherwise assume mouse follows boot report layout
+        if (hid->mouse.Length == 0)
+          process_mouse_report(hid, &HidMouseBootLayout, report, len, time);
+        else
+        if (hid->mouse.ReportId == rpt_info->report_id)
+          process_mouse_report(hid, &hid->mouse, report, len, time);
         break;
 
       default:
@@ -0,0 +1,283 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2024 Thorsten Brehm
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/* hid_mouse.c: Report descriptor parser for report protocol mice. */
+
+#include <string.h>
+#include "usb/hid_mouse.h"
+
+/* HID usages (HID Usage Tables) */
+#define HID_PAGE_DESKTOP        0x01
+#define HID_PAGE_BUTTON         0x09
+#define HID_DESKTOP_MOUSE       0x02
+#define HID_DESKTOP_X           0x30
+#define HID_DESKTOP_Y           0x31
+#define HID_DESKTOP_WHEEL       0x38
+
+/* Short item tags, including their type (HID 1.11, 6.2.2) */
+#define HID_ITEM_INPUT          0x80
+#define HID_ITEM_OUTPUT         0x90
+#define HID_ITEM_COLLECTION     0xA0
+#define HID_ITEM_FEATURE        0xB0
+#define HID_ITEM_END_COLLECTION 0xC0
+#define HID_ITEM_USAGE_PAGE     0x04
+#define HID_ITEM_LOGICAL_MIN    0x14
+#define HID_ITEM_REPORT_SIZE    0x74
+#define HID_ITEM_REPORT_ID      0x84
+#define HID_ITEM_REPORT_COUNT   0x94
+#define HID_ITEM_PUSH           0xA4
+#define HID_ITEM_POP            0xB4
+#define HID_ITEM_USAGE          0x08
+#define HID_ITEM_USAGE_MIN      0x18
+#define HID_ITEM_USAGE_MAX      0x28
+#define HID_ITEM_LONG           0xFE
+
+/* Input item flags */
+#define HID_INPUT_CONSTANT      0x01
+#define HID_INPUT_VARIABLE      0x02
+#define HID_INPUT_RELATIVE      0x04
+
+#define HID_COLLECTION_APPLICATION 0x01
+
+/* Parser limits */
+#define HID_MAX_USAGES          16
+#define HID_MAX_REPORT_IDS      8
+#define HID_MAX_PUSH            2
+#define HID_MAX_FIELD_BITS      24
+
+const THidMouseLayout HidMouseBootLayout =
+{
+    .ReportId = 0,
+    .Length   = 3,
+    .Buttons  = { .Byte = 0, .Bytes = 1, .Shift = 0, .Mask = 0xff, .Sign = 0 },
+    .X        = { .Byte = 1, .Bytes = 1, .Shift = 0, .Mask = 0xff, .Sign = 0x80 },
+    .Y        = { .Byte = 2, .Bytes = 1, .Shift = 0, .Mask = 0xff, .Sign = 0x80 },
+    .Wheel    = { 0 }
+};
+
+/** Global items (which PUSH/POP save and restore) */
+typedef struct
+{
+    uint16_t UsagePage;
+    int32_t  LogicalMin;
+    uint32_t ReportSize;
+    uint32_t ReportCount;
+    uint8_t  ReportId;
+} THidGlobals;
+
+/** Precompute the extraction of a field at the given bit position in the report. */
+static void hidFieldSet(THidField* Field, uint32_t BitPos, uint32_t Bits, bool Signed)
+{
+    Field->Byte  = BitPos / 8;
+    Field->Shift = BitPos % 8;
+    Field->Bytes = (Field->Shift + Bits + 7) / 8;
+    Field->Mask  = (Bits < 32) ? (1u << Bits) - 1 : 0xffffffff;
+    Field->Sign  = (Signed) ? 1u << (Bits-1) : 0;
+}
+
+bool hidMouseParseDescriptor(THidMouseLayout* Layout, uint8_t const* Descriptor, uint16_t Length)
+{
+    THidGlobals Globals = { 0 };
+    THidGlobals Stack[HID_MAX_PUSH];
+    uint32_t    StackDepth = 0;
+
+    // local items, cleared after each main item
+    uint32_t Usages[HID_MAX_USAGES];
+    uint32_t UsageCount = 0;
+    uint32_t UsageMin = 0, UsageMax = 0;
+
+    // bit position within each report
+    uint8_t  ReportIds[HID_MAX_REPORT_IDS] = { 0 };
+    uint32_t ReportBits[HID_MAX_REPORT_IDS] = { 0 };
+    uint32_t ReportCount = 1;
+
+    // collection nesting, and the level of the Mouse application collection (0: outside)
+    uint32_t Depth = 0, MouseDepth = 0;
+    bool     Found = false;
+
+    memset(Layout, 0, sizeof(*Layout));
+
+    for (uint32_t Pos = 0; Pos < Length;)
+    {
+        uint8_t Prefix = Descriptor[Pos++];
+        if (Prefix == HID_ITEM_LONG)
+        {
+            // long items: skip (data size in the next byte)
+            Pos += (Pos < Length) ? Descriptor[Pos] + 2 : 0;
+            continue;
+        }
+        uint32_t Size = (Prefix & 3) == 3 ? 4 : (Prefix & 3);
+        if (Pos + Size > Length)
+            break;
+        uint32_t Data = 0;
+        for (uint32_t i=0;i<Size;i++)
+            Data |= Descriptor[Pos+i] << (8*i);
+        int32_t SignedData = (Size == 0) ? 0 : (Size == 4) ? (int32_t) Data :
+                             (int32_t)(Data << (32-8*Size)) >> (32-8*Size);
+        Pos += Size;
+
+        switch (Prefix & 0xFC)
+        {
+            case HID_ITEM_USAGE_PAGE:   Globals.UsagePage   = Data; break;
+            case HID_ITEM_LOGICAL_MIN:  Globals.LogicalMin  = SignedData; break;
+            case HID_ITEM_REPORT_SIZE:  Globals.ReportSize  = Data; break;
+            case HID_ITEM_REPORT_COUNT: Globals.ReportCount = Data; break;
+            case HID_ITEM_REPORT_ID:
+            {
+                uint32_t i;
+                Globals.ReportId = Data;
+                for (i=0;(i<ReportCount)&&(ReportIds[i] != Data);i++);
+                if ((i == ReportCount)&&(ReportCount < HID_MAX_REPORT_IDS))
+                    ReportIds[ReportCount++] = Data;
+                break;
+            }
+            case HID_ITEM_PUSH:
+                if (StackDepth < HID_MAX_PUSH)
+                    Stack[StackDepth++] = Globals;
+                break;
+            case HID_ITEM_POP:
+                if (StackDepth > 0)
+                    Globals = Stack[--StackDepth];
+                break;
+
+            // usages: 32bit usages include the usage page
+            case HID_ITEM_USAGE:
+                if (UsageCount < HID_MAX_USAGES)
+                    Usages[UsageCount++] = (Size == 4) ? Data : (Globals.UsagePage << 16) | Data;
+                break;
+            case HID_ITEM_USAGE_MIN:
+                UsageMin = (Size == 4) ? Data : (Globals.UsagePage << 16) | Data;
+                break;
+            case HID_ITEM_USAGE_MAX:
+                UsageMax = (Size == 4) ? Data : (Globals.UsagePage << 16) | Data;
+                break;
+
+            case HID_ITEM_COLLECTION:
+                Depth++;
+                if ((Data == HID_COLLECTION_APPLICATION)&&(UsageCount > 0)&&
+                    (Usages[0] == ((HID_PAGE_DESKTOP << 16) | HID_DESKTOP_MOUSE))&&(!MouseDepth))
+                {
+                    MouseDepth = Depth;
+                }
+                UsageCount = UsageMin = UsageMax = 0;
+                break;
+            case HID_ITEM_END_COLLECTION:
+                if (Depth == MouseDepth)
+                    MouseDepth = 0;
+                if (Depth > 0)
+                    Depth--;
+                UsageCount = UsageMin = UsageMax = 0;
+                break;
+
+            case HID_ITEM_INPUT:
+            {
+                uint32_t r;
+                for (r=0;(r<ReportCount)&&(ReportIds[r] != Globals.ReportId);r++);
+                if (r == ReportCount)
+                {
+                    // too many reports: bit positions of this one are unknown, skip its fields
+                    UsageCount = UsageMin = UsageMax = 0;
+                    break;
+                }
+                uint32_t BitPos = ReportBits[r];
+                ReportBits[r] += Globals.ReportSize * Globals.ReportCount;
+
+                // only variable fields of the mouse's report (the first report with a matching field)
+                if ((!MouseDepth)||(Data & (HID_INPUT_CONSTANT|HID_INPUT_VARIABLE)) != HID_INPUT_VARIABLE)
+                    break;
+                if ((Found)&&(Globals.ReportId != Layout->ReportId))
+                    break;
+
+                bool Signed = (Globals.LogicalMin < 0);
+                uint32_t Bits = Globals.ReportSize;
+                for (uint32_t i=0;i<Globals.ReportCount;i++, BitPos += Bits)
+                {
+                    uint32_t Usage;
+                    if (UsageMin || UsageMax)
+                    {
+                        Usage = UsageMin + i;
+                        if (Usage > UsageMax)
+                            break;
+                    }
+                    else
+                    if (UsageCount > 0)
+                        Usage = Usages[(i < UsageCount) ? i : UsageCount-1];
+                    else
+                        break;
+
+                    THidField* Field = NULL;
+                    if (Usage == ((HID_PAGE_BUTTON << 16) | 1))
+                    {
+                        // buttons: consecutive 1bit fields, starting with button 1
+                        if ((Bits == 1)&&(!Layout->Buttons.Bytes))
+                        {
+                            uint32_t Count = Globals.ReportCount - i;
+                            hidFieldSet(&Layout->Buttons, BitPos, (Count > 8) ? 8 : Count, false);
+                            Field = &Layout->Buttons;
+                        }
+                    }
+                    else
+                    if ((Data & HID_INPUT_RELATIVE)&&(Bits >= 2)&&(Bits <= HID_MAX_FIELD_BITS))
+                    {
+                        // pointer movement and wheel: only relative values
+                        if ((Usage == ((HID_PAGE_DESKTOP << 16) | HID_DESKTOP_X))&&(!Layout->X.Bytes))
+                            Field = &Layout->X;
+                        else
+                        if ((Usage == ((HID_PAGE_DESKTOP << 16) | HID_DESKTOP_Y))&&(!Layout->Y.Bytes))
+                            Field = &Layout->Y;
+                        else
+                        if ((Usage == ((HID_PAGE_DESKTOP << 16) | HID_DESKTOP_WHEEL))&&(!Layout->Wheel.Bytes))
+                            Field = &Layout->Wheel;
+                        if (Field)
+                            hidFieldSet(Field, BitPos, Bits, Signed);
+                    }
+
+                    if (Field)
+                    {
+                        Layout->ReportId = Globals.ReportId;
+                        Found = true;
+                        if (Field->Byte + Field->Bytes > Layout->Length)
+                            Layout->Length = Field->Byte + Field->Bytes;
+                    }
+                }
+                UsageCount = UsageMin = UsageMax = 0;
+                break;
+            }
+            case HID_ITEM_OUTPUT:
+            case HID_ITEM_FEATURE:
+                UsageCount = UsageMin = UsageMax = 0;
+                break;
+            default:
+                break;
+        }
+    }
+
+    if ((!Layout->X.Bytes)||(!Layout->Y.Bytes))
+    {
+        memset(Layout, 0, sizeof(*Layout));
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,81 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2024 Thorsten Brehm
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/* hid_mouse.h: Report protocol mouse support.
+
+   The report descriptor of a mouse is parsed once when the device is mounted,
+   into the bit positions of its buttons, X, Y and wheel fields. Each report is
+   then decoded with a few loads and shifts, at the full resolution of the
+   device (boot protocol reports are limited to 8bit deltas).
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/** Bit field of an input report, precomputed for extraction */
+typedef struct
+{
+    uint8_t  Byte;   /**< first byte of the field (after the report ID) */
+    uint8_t  Bytes;  /**< number of bytes covering the field (0: field not present) */
+    uint8_t  Shift;  /**< bit position of the field in its first byte */
+    uint32_t Mask;   /**< field mask, after shifting */
+    uint32_t Sign;   /**< sign bit of signed fields, 0 for unsigned fields */
+} THidField;
+
+/** Layout of a mouse's input report */
+typedef struct
+{
+    uint8_t   ReportId;  /**< report ID (first byte of the report), 0: the device does not use report IDs */
+    uint8_t   Length;    /**< minimum report length, excluding the report ID (0: no usable layout) */
+    THidField Buttons;   /**< button 1 in bit 0, button 2 in bit 1, ... */
+    THidField X, Y, Wheel;
+} THidMouseLayout;
+
+/** Layout of boot protocol mouse reports */
+extern const THidMouseLayout HidMouseBootLayout;
+
+/** Parse a report descriptor for the input report of a relative pointing device (Mouse application
+ *  collection). Returns false (and an empty layout) when the descriptor has no usable X/Y fields. */
+extern bool hidMouseParseDescriptor(THidMouseLayout* Layout, uint8_t const* Descriptor, uint16_t Length);
+
+/** Extract a field from a report (the report must be at least Layout->Length bytes long). */
+static inline int32_t hidFieldGet(const THidField* Field, uint8_t const* Report)
+{
+    uint8_t const* p = &Report[Field->Byte];
+    uint32_t Value;
+    switch (Field->Bytes)
+    {
+        case 0:  return 0;
+        case 1:  Value = p[0]; break;
+        case 2:  Value = p[0] | (p[1]<<8); break;
+        case 3:  Value = p[0] | (p[1]<<8) | (p[2]<<16); break;
+        default: Value = p[0] | (p[1]<<8) | (p[2]<<16) | ((uint32_t)p[3]<<24); break;
+    }
+    Value = (Value >> Field->Shift) & Field->Mask;
+    // sign extension
+    return (int32_t)(Value ^ Field->Sign) - (int32_t)Field->Sign;
+}
@@ -33,6 +33,8 @@
 #include "hardware/gpio.h"
 #include "tusb.h"
 #include "dma/dmacopy.h"
+#include "util/doorbell.h"
+#include "util/profiler.h"
 
 #ifdef FUNCTION_MOUSE
   #include "mouse/MouseInterfaceCard.h"
@@ -93,9 +95,8 @@ void DELAYED_COPY_CODE(usb_led_blinking)(void)
   const uint32_t interval_ms = 500;
   if (millis() - start_ms < interval_ms)
     return;
-  // LED indicates when core1 exceeded 300ns execution time
-  gpio_put(PICO_DEFAULT_LED_PIN, ((0x00FFFFFF-ProfilerMaxTime)>0x4a));//each tick is 4ns
-  //OK:4a,BAD:0x47
+  // LED indicates when core1 exceeded its deadline (each tick is a system clock cycle)
+  gpio_put(PICO_DEFAULT_LED_PIN, ((0x00FFFFFF-ProfilerMaxTime)>PROFILER_DEADLINE_TICKS));
   // reset profiler measurement
   ProfilerMaxTime = 0x00FFFFFF;
 #elif (FUNCTION_LED_MODE==1)
@@ -164,6 +165,9 @@ void DELAYED_COPY_CODE(usb_main)(void)
 
   while (1)
   {
+    // doorbells are just wake-up calls: all tasks are checked below anyway
+    DOORBELL_COLLECT();
+
     // tinyusb host task
     tuh_task();
 
@@ -183,6 +187,9 @@ void DELAYED_COPY_CODE(usb_main)(void)
     usb_led_blinking();
 #endif
 
+    // sleep until the next USB interrupt, doorbell from core1 or timeout.
+    // Doorbells rung while we were busy return immediately (event flag is latched).
+    DOORBELL_WAIT();
   }
 }
 
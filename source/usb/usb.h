@@ -25,7 +25,8 @@
 
 extern void    usb_main(void);
 extern void    usb_reset(void);
+extern void    usb_core1_init(void);
 extern void    usb_buswrite(uint32_t address, uint32_t value);
-extern uint8_t usb_busread(uint32_t address);
+extern void    usb_busread(uint32_t address);
 
 #endif
@@ -0,0 +1,70 @@
+/* 
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2024 Thorsten Brehm
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/* doorbell.h: core1 notifies core0 through the SIO inter-core FIFO, when something
+   needs core0's attention (PIA port B writes). Core0 sleeps in WFE in
+   between USB interrupts and doorbells, instead of busy looping. This reduces
+   SRAM/bus fabric contention with core1's time critical bus cycle processing. */
+
+#pragma once
+
+/** Doorbell reasons (OR'ed, when multiple doorbells were pending) */
+#define DOORBELL_PIA  (1<<0) /**< PIA port B was written */
+
+/** Maximum time core0 sleeps without any interrupt or doorbell (for timers, LED etc) */
+#define DOORBELL_TIMEOUT_US 1000
+
+#ifdef PICO_BUILD
+  #include <hardware/sync.h>
+  #include <hardware/structs/sio.h>
+  #include <pico/time.h>
+
+  /** Ring the doorbell (core1). Never blocks: when the FIFO is full, core0 has pending doorbells anyway. */
+  static __always_inline void DOORBELL_RING(uint32_t Reason)
+  {
+      if (sio_hw->fifo_st & SIO_FIFO_ST_RDY_BITS)
+          sio_hw->fifo_wr = Reason;
+      __sev();
+  }
+
+  /** Collect all pending doorbells (core0). Returns the OR'ed reasons, 0 when none were pending. */
+  static __always_inline uint32_t DOORBELL_COLLECT(void)
+  {
+      uint32_t Reasons = 0;
+      while (sio_hw->fifo_st & SIO_FIFO_ST_VLD_BITS)
+          Reasons |= sio_hw->fifo_rd;
+      // clear sticky FIFO error flags
+      sio_hw->fifo_st = 0xff;
+      return Reasons;
+  }
+
+  /** Sleep until an interrupt, a doorbell or the timeout (core0). */
+  #define DOORBELL_WAIT() best_effort_wfe_or_timeout(make_timeout_time_us(DOORBELL_TIMEOUT_US))
+#else
+  /* host tools: core0 is polled, no doorbells */
+  #define DOORBELL_RING(Reason) {}
+  #define DOORBELL_COLLECT()    0
+  #define DOORBELL_WAIT()       {}
+#endif
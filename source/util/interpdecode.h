@@ -0,0 +1,84 @@
+/* 
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2024 Thorsten Brehm
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/* interpdecode.h: Core1 uses the SIO interpolator interp0 to decode the raw PIO bus
+   cycle word (address in bits 25-10) straight into pointers for 6502 read cycles:
+     lane 0: base0 + address bits 0-7  => byte in the currently selected slot ROM page
+     lane 1: base1 + address bits 0-1  => PIA register in the precomputed read image
+   The interpolators are per-core: only core1 may use these macros. */
+
+#pragma once
+
+#define INTERP_DECODE_ADDRESS_SHIFT 10
+
+#ifdef PICO_BUILD
+  #include <hardware/interp.h>
+
+  /** Configure core1's interp0. Rom: current slot ROM page. Registers: PIA read image. */
+  static inline void INTERP_DECODE_INIT(const uint8_t* Rom, const volatile uint8_t* Registers)
+  {
+      interp_config cfg = interp_default_config();
+      interp_config_set_shift(&cfg, INTERP_DECODE_ADDRESS_SHIFT);
+      interp_config_set_mask(&cfg, 0, 7);
+      interp_set_config(interp0, 0, &cfg);
+
+      cfg = interp_default_config();
+      // lane 1 also decodes accumulator 0
+      interp_config_set_cross_input(&cfg, true);
+      interp_config_set_shift(&cfg, INTERP_DECODE_ADDRESS_SHIFT);
+      interp_config_set_mask(&cfg, 0, 1);
+      interp_set_config(interp0, 1, &cfg);
+
+      interp0->accum[0] = 0;
+      interp0->base[0]  = (uint32_t) Rom;
+      interp0->base[1]  = (uint32_t) Registers;
+  }
+
+  /** Provide the raw PIO bus cycle word */
+  #define INTERP_DECODE_INPUT(value)  interp0->accum[0] = (value)
+  /** Select a new slot ROM page */
+  #define INTERP_DECODE_ROMPAGE(Rom)  interp0->base[0] = (uint32_t) (Rom)
+  /** Slot ROM byte for the current bus cycle */
+  #define INTERP_DECODE_ROM()         (*(const uint8_t*) interp0->peek[0])
+  /** PIA register (read image) for the current bus cycle */
+  #define INTERP_DECODE_REGISTER()    (*(const volatile uint8_t*) interp0->peek[1])
+#else
+  /* Host build: emulate the lane configuration above. */
+  static uint32_t               InterpDecodeAccum;
+  static const uint8_t*         InterpDecodeRom;
+  static const volatile uint8_t* InterpDecodeRegisters;
+
+  static inline void INTERP_DECODE_INIT(const uint8_t* Rom, const volatile uint8_t* Registers)
+  {
+      InterpDecodeAccum     = 0;
+      InterpDecodeRom       = Rom;
+      InterpDecodeRegisters = Registers;
+  }
+
+  #define INTERP_DECODE_INPUT(value)  InterpDecodeAccum = (value)
+  #define INTERP_DECODE_ROMPAGE(Rom)  InterpDecodeRom = (Rom)
+  #define INTERP_DECODE_ROM()         InterpDecodeRom[(InterpDecodeAccum >> INTERP_DECODE_ADDRESS_SHIFT) & 0xff]
+  #define INTERP_DECODE_REGISTER()    InterpDecodeRegisters[(InterpDecodeAccum >> INTERP_DECODE_ADDRESS_SHIFT) & 0x3]
+#endif
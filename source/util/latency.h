@@ -0,0 +1,107 @@
+/* 
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2024 Thorsten Brehm
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/* latency.h: Latency statistics (core0). Times are A2_TIMESTAMP units, which are
+   microseconds on the PICO. Besides count, minimum, maximum and sum, a log-linear
+   histogram (8 buckets per power of 2, i.e. 12.5% resolution) provides percentiles
+   for sub-millisecond report intervals as well as for multi-frame latencies. */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/** Number of histogram buckets: values of 0..7 have their own buckets, values beyond 2^24 share the last one */
+#define LATENCY_BUCKETS     176
+#define LATENCY_MAX         ((1u << 24) - 1)
+
+typedef struct
+{
+    uint32_t Count;
+    uint32_t Min;
+    uint32_t Max;
+    uint64_t Sum;
+    uint32_t Histogram[LATENCY_BUCKETS];
+} TLatencyStats;
+
+/** Histogram bucket of a time. */
+static inline uint32_t latencyBucket(uint32_t Time)
+{
+    if (Time > LATENCY_MAX)
+        Time = LATENCY_MAX;
+    if (Time < 8)
+        return Time;
+    uint32_t Msb = 31 - __builtin_clz(Time);
+    return ((Msb - 2) << 3) | ((Time >> (Msb - 3)) & 7);
+}
+
+/** Largest time of a histogram bucket. */
+static inline uint32_t latencyBucketMax(uint32_t Bucket)
+{
+    if (Bucket < 8)
+        return Bucket;
+    uint32_t Shift = (Bucket >> 3) - 1;
+    return (((8 | (Bucket & 7)) + 1) << Shift) - 1;
+}
+
+static inline void latencyClear(TLatencyStats* Stats)
+{
+    Stats->Count = 0;
+    Stats->Min   = UINT32_MAX;
+    Stats->Max   = 0;
+    Stats->Sum   = 0;
+    for (uint32_t i=0;i<LATENCY_BUCKETS;i++)
+        Stats->Histogram[i] = 0;
+}
+
+static inline void latencyAdd(TLatencyStats* Stats, uint32_t Time)
+{
+    Stats->Count++;
+    Stats->Sum += Time;
+    if (Time < Stats->Min)
+        Stats->Min = Time;
+    if (Time > Stats->Max)
+        Stats->Max = Time;
+    Stats->Histogram[latencyBucket(Time)]++;
+}
+
+static inline uint32_t latencyAverage(const TLatencyStats* Stats)
+{
+    return (Stats->Count) ? (uint32_t)(Stats->Sum / Stats->Count) : 0;
+}
+
+/** Upper bound of the given percentile (in 1/10%, e.g. 990 for p99), 0 without samples. */
+static inline uint32_t latencyPercentile(const TLatencyStats* Stats, uint32_t Permille)
+{
+    uint64_t Rank = ((uint64_t) Stats->Count * Permille + 999) / 1000;
+    uint32_t Sum  = 0;
+    for (uint32_t i=0;(i<LATENCY_BUCKETS)&&(Rank);i++)
+    {
+        Sum += Stats->Histogram[i];
+        if (Sum >= Rank)
+            return (latencyBucketMax(i) < Stats->Max) ? latencyBucketMax(i) : Stats->Max;
+    }
+    return 0;
+}
@@ -23,9 +23,33 @@
  *
  */
 
-#include "hardware/structs/systick.h"
+/* Profiled core1 bus interface paths. */
+#define PROFILER_PATH_DEVSEL_READ   0 /**< PIA register read */
+#define PROFILER_PATH_DEVSEL_WRITE  1 /**< PIA register write */
+#define PROFILER_PATH_IOSEL_READ    2 /**< slot ROM read */
+#define PROFILER_PATH_IDLE          3 /**< bus cycle not addressing the card */
+#define PROFILER_PATH_RESET         4 /**< 6502 reset detected */
+#define PROFILER_PATH_IOSEL_WRITE   5 /**< slot ROM write (ignored) */
+#define PROFILER_PATHS              6
+
+/* Number of log2 buckets per histogram: bucket n counts times of 2^(n-1)...2^n-1 SysTicks. */
+#define PROFILER_BUCKETS            16
+
+/* Histograms are visible to the 6502 through the RDMEMMOUSE command at these
+ * (unused) 6805 addresses: 16 buckets x 32bit little-endian counters per path. */
+#define PROFILER_RDMEM_BASE         0x1000
+#define PROFILER_RDMEM_SIZE         (PROFILER_PATHS*PROFILER_BUCKETS*4)
+
+/* Time budget of core1 per bus cycle, shown by the LED of PROFILER builds. */
+#define PROFILER_DEADLINE_NS        296
+#define PROFILER_DEADLINE_TICKS     ((uint32_t)(PROFILER_DEADLINE_NS*CONFIG_SYSCLOCK/1000))
 
 #ifdef FUNCTION_PROFILER
+	#include "hardware/structs/systick.h"
+
+	extern uint32_t ProfilerMaxTime;
+	extern uint32_t ProfilerHistogram[PROFILER_PATHS][PROFILER_BUCKETS];
+	extern uint8_t  ProfilerLog2[256];
 
 	// enable systick timer, but keep timer exception disabled
 	#define PROFILER_INIT(MaxTime) \
@@ -34,20 +58,46 @@
 		systick_hw->rvr = 0x00FFFFFF;\
 		systick_hw->cvr = 0x00FFFFFF;\
 		MaxTime         = 0x00FFFFFF;\
+		for (uint32_t i=0,b=0;i<256;i++)\
+		{\
+			if (i >= (1u<<b)) b++;\
+			ProfilerLog2[i] = b;\
+		}\
+		PROFILER_CLEAR();\
+	}
+
+	// clear all histograms
+	#define PROFILER_CLEAR() \
+	{\
+		for (uint32_t i=0;i<PROFILER_PATHS*PROFILER_BUCKETS;i++)\
+			((uint32_t*)ProfilerHistogram)[i] = 0;\
 	}
 
 	// start time measurement (count-down timer)
 	#define PROFILER_START(){ systick_hw->cvr = 0x00FFFFFF;}
 
-	// stop time measurement and calculate maximum
+	// stop time measurement, update histogram of given path and calculate maximum
 	// elapsed time is actually: 0x00FFFFFF-MaxTime
-	#define PROFILER_STOP(MaxTime) { \
+	// (the reset path is not considered for the maximum)
+	#define PROFILER_STOP(MaxTime, Path) { \
 		uint32_t t = systick_hw->cvr; \
-		if (t<MaxTime) MaxTime = t;\
+		uint32_t elapsed = 0x00FFFFFF-t; \
+		uint32_t bucket; \
+		if (elapsed < 256) \
+			bucket = ProfilerLog2[elapsed]; \
+		else \
+		{ \
+			bucket = 9; \
+			while ((elapsed >= (1u<<bucket))&&(bucket < PROFILER_BUCKETS-1)) \
+				bucket++; \
+		} \
+		ProfilerHistogram[Path][bucket]++; \
+		if ((t<MaxTime)&&(Path != PROFILER_PATH_RESET)) MaxTime = t;\
 	}
 
 #else
 	#define PROFILER_INIT(x)  {}
+	#define PROFILER_CLEAR()  {}
 	#define PROFILER_START() {}
-	#define PROFILER_STOP(x)  {}
+	#define PROFILER_STOP(x, Path)  { (void) (Path); }
 #endif
@@ -0,0 +1,97 @@
+/* 
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2024 Thorsten Brehm
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/* spscqueue.h: Lock-free single-producer/single-consumer queue, passing events
+   from core1 (bus interface, producer) to core0 (consumer).
+   Head is only written by the producer, Tail only by the consumer. Both are free
+   running, so the queue can be filled completely. Entries are only released
+   when the consumer pops them, which allows the consumer to peek, process and
+   pop - so the producer can tell when all events were completely processed.
+   Memory barriers order the entries (and anything else the consumer wrote while
+   processing an event) against the Head/Tail updates seen by the other core. */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef PICO_BUILD
+  #include <hardware/sync.h>
+  #define SPSC_QUEUE_BARRIER() __dmb()
+#else
+  #define SPSC_QUEUE_BARRIER() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#endif
+
+/** Number of queue entries (power of 2) */
+#define SPSC_QUEUE_SIZE 32
+
+typedef struct
+{
+    volatile uint16_t Data[SPSC_QUEUE_SIZE];
+    volatile uint32_t Head;    /**< write position (producer) */
+    volatile uint32_t Tail;    /**< read position (consumer) */
+    volatile uint32_t Dropped; /**< number of events dropped, since the queue was full (producer) */
+} TSpscQueue;
+
+/** Add an event. Returns false (and counts the event as dropped) when the queue is full. */
+static __always_inline bool spscQueuePush(TSpscQueue* Queue, uint16_t Event)
+{
+    uint32_t Head = Queue->Head;
+    if (Head - Queue->Tail >= SPSC_QUEUE_SIZE)
+    {
+        Queue->Dropped++;
+        return false;
+    }
+    Queue->Data[Head & (SPSC_QUEUE_SIZE-1)] = Event;
+    // data is written before the new head position is visible
+    SPSC_QUEUE_BARRIER();
+    Queue->Head = Head+1;
+    return true;
+}
+
+/** Check if all events were consumed. When true, the producer also sees everything the consumer wrote before
+ *  its last pop. */
+static __always_inline bool spscQueueEmpty(TSpscQueue* Queue)
+{
+    bool Empty = (Queue->Head == Queue->Tail);
+    SPSC_QUEUE_BARRIER();
+    return Empty;
+}
+
+/** Read the oldest event, without releasing it (queue must not be empty). */
+static __always_inline uint16_t spscQueuePeek(TSpscQueue* Queue)
+{
+    // the entry is read after the head position which made it visible
+    SPSC_QUEUE_BARRIER();
+    return Queue->Data[Queue->Tail & (SPSC_QUEUE_SIZE-1)];
+}
+
+/** Release the oldest event (queue must not be empty). */
+static __always_inline void spscQueuePop(TSpscQueue* Queue)
+{
+    // the entry (and the results of processing it) are complete before it is released
+    SPSC_QUEUE_BARRIER();
+    Queue->Tail = Queue->Tail+1;
+}
@@ -0,0 +1,89 @@
+/* 
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2024 Thorsten Brehm
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/* vblsync.h: Phase-locked VBL. Software on a IIe/IIgs synchronizes with the video
+   scanner by polling RDVBLBAR ($C019) in a tight loop, until the VBL bit changes.
+   The bus interface does not see the data of other devices' read cycles, but the
+   last read of such a polling loop marks the moment the VBL bit changed: either
+   the start or the end of the vertical blanking.
+   Core1 timestamps the end of each polling loop. Loops are told apart by the
+   address of the branch instruction, fetched right after the $C019 read, since
+   "wait for VBL end, then wait for VBL start" loops run back-to-back. Core0 tells VBL start from end by
+   the distance between consecutive transitions (blanking vs visible screen), and
+   corrects the phase and period of the VBL bus cycle counter. */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "util/spscqueue.h"
+
+/** RDVBLBAR soft switch (IIe/IIc/IIgs) */
+#define VBLSYNC_RDVBLBAR      0xC019
+
+/** Reads of $C019 further apart than this (in timestamp units, about 1 bus cycle) belong to different polling loops */
+#define VBLSYNC_POLL_GAP      32
+
+/** Minimum number of reads of a polling loop. Single reads don't wait for a VBL transition. */
+#define VBLSYNC_MIN_POLLS     2
+
+/** Maximum age of a VBL transition when it is reported (a polling loop once per frame is reported one frame
+ *  late). Older ones are dropped: core0 restores the full time from the lower 16bits of the time stamp. */
+#define VBLSYNC_MAX_AGE       0x8000
+
+typedef struct
+{
+    bool       Pending;  /**< $C019 was read in the previous bus cycle */
+    uint32_t   Poll;     /**< time of the most recent $C019 read */
+    uint32_t   LastPoll; /**< time of the previous $C019 read of the current polling loop */
+    uint32_t   Loop;     /**< address of the current polling loop's branch instruction */
+    uint32_t   Polls;    /**< number of $C019 reads of the current polling loop */
+    TSpscQueue Edges;    /**< VBL transitions (lower 16bits of the time stamp) for core0 */
+} TVblSnoop;
+
+/** Called by core1 for every $C019 read. */
+static __always_inline void vblSyncSnoop(TVblSnoop* Snoop, uint32_t Now)
+{
+    Snoop->Poll    = Now;
+    Snoop->Pending = true;
+}
+
+/** Called by core1 for the bus cycle following a $C019 read (Address: the instruction following the LDA).
+ *  A polling loop is only complete once the next one starts, but its time stamp is exact, so late
+ *  reporting doesn't matter - unless it is too late for the 16bit time stamp (VBLSYNC_MAX_AGE). */
+static __always_inline void vblSyncLoop(TVblSnoop* Snoop, uint32_t Address)
+{
+    Snoop->Pending = false;
+    if ((Address != Snoop->Loop)||(Snoop->Poll - Snoop->LastPoll > VBLSYNC_POLL_GAP))
+    {
+        // previous polling loop has ended: its last read saw the VBL bit change
+        if ((Snoop->Polls >= VBLSYNC_MIN_POLLS)&&(Snoop->Poll - Snoop->LastPoll <= VBLSYNC_MAX_AGE))
+            spscQueuePush(&Snoop->Edges, Snoop->LastPoll);
+        Snoop->Polls = 0;
+        Snoop->Loop  = Address;
+    }
+    Snoop->Polls++;
+    Snoop->LastPoll = Snoop->Poll;
+}
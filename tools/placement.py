@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+#
+# The MIT License (MIT)
+#
+# Copyright (c) 2024 Thorsten Brehm
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+
+# placement.py: Report the memory placement of core1's working set.
+# Core1's code and data are supposed to live in SCRATCH_X/SCRATCH_Y (see
+# build/delayed_copy.ld), so core1 never competes with core0 for the SRAM banks.
+
+import argparse
+import subprocess
+import sys
+
+# memory regions, as defined in build/delayed_copy.ld
+REGIONS = [
+    ("FLASH",     0x10000000, 2048*1024),
+    ("RAM",       0x20000000,  128*1024),
+    ("APPLEDATA", 0x20020000,  128*1024),
+    ("SCRATCH_X", 0x20040000,    4*1024),
+    ("SCRATCH_Y", 0x20041000,    4*1024),
+]
+
+# core1's working set: code is expected in SCRATCH_X, data in SCRATCH_Y
+CORE1_CODE = ["core1_loop", "usb_buswrite", "usb_busread", "mouseControllerPortB"]
+CORE1_DATA = ["Pia", "ROMOffset", "MouseInterfaceROM", "MouseEvents", "Core1LastPortB", "Core1Reply", "VblSnoop",
+              "reset_state",
+              "ProfilerMaxTime", "ProfilerHistogram", "ProfilerLog2"]
+
+def region(address):
+    for name, start, size in REGIONS:
+        if start <= address < start+size:
+            return name
+    return "?"
+
+def readSymbols(nm, elf):
+    """Returns a dictionary of symbol name => (address, size)."""
+    out = subprocess.run([nm, "-S", "-n", elf], check=True, capture_output=True, text=True).stdout
+    symbols = {}
+    for line in out.splitlines():
+        fields = line.split()
+        # "address size type name" (symbols without size are skipped)
+        if len(fields) != 4:
+            continue
+        address, size, _type, name = fields
+        # thumb function addresses may have bit 0 set
+        symbols[name] = (int(address, 16) & ~1, int(size, 16))
+    return symbols
+
+def main():
+    parser = argparse.ArgumentParser(description="Report memory placement of core1's working set.")
+    parser.add_argument("--nm", default="arm-none-eabi-nm", help="nm tool of the cross toolchain")
+    parser.add_argument("--strict", action="store_true", help="fail when core1's working set is not in the scratch banks")
+    parser.add_argument("elf", help="firmware ELF file")
+    args = parser.parse_args()
+
+    symbols = readSymbols(args.nm, args.elf)
+
+    usage = {}
+    for name, (address, size) in symbols.items():
+        r = region(address)
+        usage[r] = usage.get(r, 0) + size
+
+    print("Memory placement: %s" % args.elf)
+    for name, start, size in REGIONS:
+        print("  %-10s %8u of %8u bytes used by sized symbols" % (name, usage.get(name, 0), size))
+
+    errors = 0
+    print("Core1 working set:")
+    for expected, names in (("SCRATCH_X", CORE1_CODE), ("SCRATCH_Y", CORE1_DATA)):
+        for name in names:
+            if name not in symbols:
+                print("  %-22s (not present)" % name)
+                continue
+            address, size = symbols[name]
+            r = region(address)
+            status = "ok" if r == expected else "WARNING: expected in %s" % expected
+            if r != expected:
+                errors += 1
+            print("  %-22s 0x%08x %6u bytes %-10s %s" % (name, address, size, r, status))
+
+    for scratch in ("SCRATCH_X", "SCRATCH_Y"):
+        print("%s contents:" % scratch)
+        for name, (address, size) in sorted(symbols.items(), key=lambda s: s[1][0]):
+            if region(address) == scratch:
+                print("  0x%08x %6u %s" % (address, size, name))
+
+    if errors:
+        print("%u symbol(s) of core1's working set are outside the scratch banks." % errors)
+        if args.strict:
+            return 1
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())